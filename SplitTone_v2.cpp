@@ -4,222 +4,3798 @@
 //    only selects a middle-gray reference value (exactly as in the DCTL).
 //  - Processing is per-channel (RGB) with a 3-zone curve (shadows / preserve mids / highlights),
 //    plus an optional on-screen curve overlay.
+//  - Built with SPLITTONE_NO_OVERLAY (CMake does so when OpenGL is missing), there is no viewer
+//    overlay and no OpenGL dependency; Burn In Curve still draws the curve into the image.
 
 #include "ofxsImageEffect.h"
 #include "ofxsMultiThread.h"
-#include "ofxsProcessing.H"
+#include "ofxsInteract.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+#ifndef SPLITTONE_NO_OVERLAY
+#if defined(__APPLE__)
+#include <OpenGL/gl.h>
+#else
+#include <GL/gl.h>
+#endif
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SPLITTONE_X86_DISPATCH 1
+#include <immintrin.h>
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <emmintrin.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifdef SPLITTONE_WITH_TBB
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+#endif
 
 #define kPluginIdentifier "com.jpzhao.SplitToneV2"
 #define kPluginName       "Split Tone v2 (DCTL Port)"
 #define kPluginGrouping   "Color"
 #define kPluginVersionMajor 1
-#define kPluginVersionMinor 0
+#define kPluginVersionMinor 1
+
+// Bumped when a release changes what saved parameter values mean; see SplitToneEffect::upgradeParams.
+static const int kParamsVersion = 1;
+
+// Burn In Curve for values saved under paramsVersion version. Before 1.1 (version 0) Show Curve drew
+// the curve into the rendered image; it now only drives the viewer overlay, so it carries over.
+static inline bool upgradedBurnInCurve(int version, bool showCurve, bool burnInCurve) {
+  return burnInCurve || (version < 1 && showCurve);
+}
+
+// Whether values saved under paramsVersion version change on upgrade: only a Show Curve that is on
+// or animated does. Instances with nothing to carry over (every new one included) need the stamp alone.
+template <class BoolParam>
+static bool paramsNeedUpgrade(int version, const BoolParam& showCurve) {
+  if (version >= kParamsVersion) return false;
+  if (showCurve.getNumKeys() > 0) return true;
+  bool show = false;
+  showCurve.getValue(show);
+  return upgradedBurnInCurve(version, show, false);
+}
+
+// Carries Show Curve over to Burn In Curve. An animated Show Curve is copied key by key: boolean
+// params hold each key's value until the next, so Burn In Curve then has its value at every time.
+template <class BoolParam>
+static void upgradeBurnInCurve(int version, const BoolParam& showCurve, BoolParam& burnInCurve) {
+  const unsigned int keys = showCurve.getNumKeys();
+  if (!keys) {
+    bool show = false;
+    bool burnIn = false;
+    showCurve.getValue(show);
+    burnInCurve.getValue(burnIn);
+    if (!burnIn && upgradedBurnInCurve(version, show, burnIn)) burnInCurve.setValue(true);
+    return;
+  }
+  // Read everything first: each key written holds its value over the times of later ones.
+  std::vector<double> times(keys);
+  std::vector<char> values(keys);
+  for (unsigned int k = 0; k < keys; ++k) {
+    times[k] = showCurve.getKeyTime((int)k);
+    bool show = false;
+    bool burnIn = false;
+    showCurve.getValueAtTime(times[k], show);
+    burnInCurve.getValueAtTime(times[k], burnIn);
+    values[k] = upgradedBurnInCurve(version, show, burnIn);
+  }
+  for (unsigned int k = 0; k < keys; ++k) burnInCurve.setValueAtTime(times[k], values[k] != 0);
+}
+
+// Writes kParamsVersion unless it is already there; returns whether it wrote.
+template <class IntParam>
+static bool stampParamsVersion(IntParam& paramsVersion) {
+  int version = 0;
+  paramsVersion.getValue(version);
+  if (version == kParamsVersion) return false;
+  paramsVersion.setValue(kParamsVersion);
+  return true;
+}
+
+// The upgrade an instance gets when it is created: values that change are carried over and stamped
+// as one undoable edit of effect; anything else is left to stampParamsVersion. Returns whether it wrote.
+template <class Effect, class IntParam, class BoolParam>
+static bool upgradeParamsOnCreate(Effect& effect, IntParam& paramsVersion, const BoolParam& showCurve,
+                                  BoolParam& burnInCurve) {
+  int version = 0;
+  paramsVersion.getValue(version);
+  if (!paramsNeedUpgrade(version, showCurve)) return false;
+  effect.beginEditBlock("Upgrade Split Tone parameters");
+  upgradeBurnInCurve(version, showCurve, burnInCurve);
+  stampParamsVersion(paramsVersion);
+  effect.endEditBlock();
+  return true;
+}
+
+static inline float clampf(float v, float lo, float hi) {
+  return std::max(lo, std::min(hi, v));
+}
+
+static inline float getMiddleGray(int preset) {
+  static const float mg[20] = {
+    0.180f, // Linear
+    0.413f, // ACEScc
+    0.413f, // ACEScct
+    0.391f, // ARRI LogC3
+    0.278f, // ARRI LogC4
+    0.383f, // BMD Film Gen5
+    0.312f, // Canon Log
+    0.387f, // Canon Log2
+    0.330f, // Canon Log3
+    0.336f, // DaVinci Intermediate
+    0.398f, // DJI D-Log
+    0.459f, // Fujifilm F-Log
+    0.391f, // Fujifilm F-Log2
+    0.458f, // Gamma 2.2
+    0.489f, // Gamma 2.4
+    0.363f, // Nikon N-Log
+    0.423f, // Panasonic V-Log
+    0.333f, // RED Log3G10
+    0.410f, // Sony S-Log3
+    0.488f  // Apple Log
+  };
+  preset = std::max(0, std::min(19, preset));
+  return mg[preset];
+}
+
+// Bit-reproducible pow for ratio in [0,1] and the slider's positive exponents, built only from
+// IEEE basic operations (no libm, no FMA) so every CPU and SIMD width produces the same bits.
+// Evaluated in double as exp2(p * log2(x)); the error (~1e-12 relative) is far below float
+// resolution, so results match std::pow to within an ulp.
+static inline float portablePowf(float x, float p) {
+  if (x <= 0.0f) return 0.0f;
+  if (x == 1.0f) return 1.0f;
+
+  // x = m * 2^e with m in [sqrt(1/2), sqrt(2))
+  const double xd = (double)x;
+  uint64_t bits;
+  std::memcpy(&bits, &xd, sizeof(bits));
+  int e = (int)((bits >> 52) & 0x7ff) - 1023;
+  bits = (bits & 0x000fffffffffffffull) | 0x3ff0000000000000ull;
+  double m;
+  std::memcpy(&m, &bits, sizeof(m));
+  if (m > 1.4142135623730951) { m *= 0.5; ++e; }
+
+  // log2(m) = 2/ln2 * atanh(s), s = (m-1)/(m+1), |s| < 0.172
+  const double s = (m - 1.0) / (m + 1.0);
+  const double s2 = s * s;
+  double t = 1.0 / 15.0;
+  t = t * s2 + 1.0 / 13.0;
+  t = t * s2 + 1.0 / 11.0;
+  t = t * s2 + 1.0 / 9.0;
+  t = t * s2 + 1.0 / 7.0;
+  t = t * s2 + 1.0 / 5.0;
+  t = t * s2 + 1.0 / 3.0;
+  t = t * s2 + 1.0;
+  const double log2x = (double)e + 2.8853900817779268 * s * t; // 2/ln2
+
+  const double y = (double)p * log2x;
+  if (y < -200.0) return 0.0f; // far below the smallest float denormal
+
+  // 2^y = 2^k * e^(f*ln2), f in [-0.5, 0.5]
+  const double k = std::floor(y + 0.5);
+  const double r = (y - k) * 0.6931471805599453;
+  double q = 1.0 / 3628800.0;
+  q = q * r + 1.0 / 362880.0;
+  q = q * r + 1.0 / 40320.0;
+  q = q * r + 1.0 / 5040.0;
+  q = q * r + 1.0 / 720.0;
+  q = q * r + 1.0 / 120.0;
+  q = q * r + 1.0 / 24.0;
+  q = q * r + 1.0 / 6.0;
+  q = q * r + 0.5;
+  q = q * r + 1.0;
+  q = q * r + 1.0;
+
+  const uint64_t scaleBits = (uint64_t)((int64_t)k + 1023) << 52;
+  double scale;
+  std::memcpy(&scale, &scaleBits, sizeof(scale));
+  return (float)(q * scale);
+}
+
+struct StdPow {
+  static float pow(float x, float p) { return std::pow(x, p); }
+};
+
+struct PortablePow {
+  static float pow(float x, float p) { return portablePowf(x, p); }
+};
+
+template <class ShadowPow, class HighlightPow = ShadowPow>
+static inline float applyCurveWith(float x,
+                                   float shadowEnd,
+                                   float highlightStart,
+                                   float pShadow,
+                                   float pHighlight) {
+  // Match DCTL behavior: clamp only to >= 0
+  x = std::max(0.0f, x);
+
+  // Zone 1: Shadows
+  if (x <= shadowEnd) {
+    if (shadowEnd > 0.0f) {
+      float ratio = x / shadowEnd;
+      ratio = clampf(ratio, 0.0f, 1.0f);
+      return shadowEnd * ShadowPow::pow(ratio, pShadow);
+    }
+    return x;
+  }
+  // Zone 2: Preserve mids (linear passthrough)
+  if (x <= highlightStart) {
+    return x;
+  }
+  // Zone 3: Highlights (up to 1.0)
+  if (x <= 1.0f) {
+    float range = 1.0f - highlightStart;
+    if (range > 0.0f) {
+      float ratio = (x - highlightStart) / range;
+      ratio = clampf(ratio, 0.0f, 1.0f);
+      return highlightStart + range * HighlightPow::pow(ratio, pHighlight);
+    }
+    return x;
+  }
+  // Zone 4: Above 1.0
+  return x;
+}
+
+static inline float applyCurve(float x,
+                               float shadowEnd,
+                               float highlightStart,
+                               float pShadow,
+                               float pHighlight) {
+  return applyCurveWith<StdPow>(x, shadowEnd, highlightStart, pShadow, pHighlight);
+}
+
+// Exact, and NaNs come out as vcvtph2ps gives them: quieted, payload kept.
+static inline float halfToFloat(uint16_t h) {
+  const uint32_t sign = (uint32_t)(h & 0x8000u) << 16;
+  const uint32_t exp = (h >> 10) & 0x1fu;
+  uint32_t mant = h & 0x3ffu;
+  uint32_t bits;
+  if (exp == 0x1fu) {
+    bits = sign | 0x7f800000u | (mant << 13) | (mant ? 0x400000u : 0u); // Inf / quiet NaN
+  } else if (exp != 0) {
+    bits = sign | ((exp + 112u) << 23) | (mant << 13); // normal
+  } else if (mant == 0) {
+    bits = sign;                                      // +-0
+  } else {
+    uint32_t e = 113;                                 // subnormal: renormalize
+    while (!(mant & 0x400u)) { mant <<= 1; --e; }
+    bits = sign | (e << 23) | ((mant & 0x3ffu) << 13);
+  }
+  float f;
+  std::memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+// Round to nearest even, like F16C's vcvtps2ph; overflow goes to Inf, and a NaN is quieted and
+// keeps the top bits of its payload as vcvtps2ph does.
+static inline uint16_t floatToHalf(float f) {
+  uint32_t x;
+  std::memcpy(&x, &f, sizeof(x));
+  const uint32_t sign = (x >> 16) & 0x8000u;
+  const uint32_t a = x & 0x7fffffffu;
+  if (a > 0x7f800000u) return (uint16_t)(sign | 0x7e00u | ((a >> 13) & 0x3ffu)); // NaN
+  if (a == 0x7f800000u) return (uint16_t)(sign | 0x7c00u);  // Inf
+  if (a >= 0x477ff000u) return (uint16_t)(sign | 0x7c00u);  // rounds past 65504
+  if (a < 0x38800000u) {                                     // half subnormal or zero
+    if (a <= 0x33000000u) return (uint16_t)sign;              // up to 2^-25 rounds to 0
+    const uint32_t shift = 126u - (a >> 23);
+    const uint32_t mant = (a & 0x7fffffu) | 0x800000u;
+    uint32_t h = mant >> shift;
+    const uint32_t rem = mant & ((1u << shift) - 1u), halfway = 1u << (shift - 1u);
+    if (rem > halfway || (rem == halfway && (h & 1u))) ++h;
+    return (uint16_t)(sign | h);
+  }
+  uint32_t h = (a >> 13) - (112u << 10);                     // rebias the exponent
+  const uint32_t rem = a & 0x1fffu;
+  if (rem > 0x1000u || (rem == 0x1000u && (h & 1u))) ++h;   // a carry rounds up the exponent
+  return (uint16_t)(sign | h);
+}
+
+// Pixel depths
+// Clips may each be 8-bit, 16-bit, half or float. Float to float is graded in place; any other pair
+// is staged through a few float rows per worker, so reading one depth and writing another happens
+// in the same pass as the grade instead of in a separate conversion pass by the host.
+static inline bool isSupportedDepth(OFX::BitDepthEnum depth) {
+  return depth == OFX::eBitDepthUByte || depth == OFX::eBitDepthUShort || depth == OFX::eBitDepthHalf ||
+         depth == OFX::eBitDepthFloat;
+}
+
+static inline int bytesPerComponent(OFX::BitDepthEnum depth) {
+  switch (depth) {
+  case OFX::eBitDepthUByte: return 1;
+  case OFX::eBitDepthUShort:
+  case OFX::eBitDepthHalf: return 2;
+  default: return 4;
+  }
+}
+
+static const int kStageRows = 8; // float rows staged per step when converting
+
+// A clip image as the workers address it: data, bounds and depth are read from the host's image once
+// per render, so a row costs one multiply-add instead of a call into the support library.
+struct ImageView {
+  char* data = nullptr;              // pixel (bounds.x1, bounds.y1)
+  OfxRectI bounds = {0, 0, 0, 0};
+  OfxRectI rod = {0, 0, 0, 0};        // region of definition
+  std::ptrdiff_t rowBytes = 0;       // may be negative
+  std::ptrdiff_t pixelBytes = 0;
+  OFX::BitDepthEnum depth = OFX::eBitDepthNone;
+
+  static ImageView of(const OFX::Image& img) {
+    ImageView v;
+    v.data = (char*)img.getPixelData();
+    v.bounds = img.getBounds();
+    v.rod = img.getRegionOfDefinition();
+    v.rowBytes = img.getRowBytes();
+    v.depth = img.getPixelDepth();
+    v.pixelBytes = 4 * bytesPerComponent(v.depth);
+    return v;
+  }
+
+  // Same contract as OFX::Image::getPixelAddress: null outside the bounds.
+  void* getPixelAddress(int x, int y) const {
+    if (!data || x < bounds.x1 || x >= bounds.x2 || y < bounds.y1 || y >= bounds.y2) return nullptr;
+    return data + (std::ptrdiff_t)(y - bounds.y1) * rowBytes + (std::ptrdiff_t)(x - bounds.x1) * pixelBytes;
+  }
+
+  OfxRectI getBounds() const { return bounds; }
+  OfxRectI getRegionOfDefinition() const { return rod; }
+  OFX::BitDepthEnum getPixelDepth() const { return depth; }
+  std::ptrdiff_t getRowBytes() const { return rowBytes; }
+};
+
+#ifdef SPLITTONE_X86_DISPATCH
+// Widest instruction set the dispatch may pick. The determinism test lowers it to render a frame
+// the way an older CPU would; the plugin never changes it.
+enum CpuLevel { kCpuBaseline, kCpuF16c, kCpuAvx2, kCpuAvx512 };
+
+static std::atomic<int>& cpuLevelLimit() {
+  static std::atomic<int> limit{kCpuAvx512};
+  return limit;
+}
+
+// vcvtph2ps / vcvtps2ph, bit-identical to halfToFloat / floatToHalf (NaNs included, see the
+// half test) but without their branches.
+static bool cpuHasF16c() {
+  static const bool has = __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+  return has && cpuLevelLimit().load(std::memory_order_relaxed) >= kCpuF16c;
+}
+
+__attribute__((target("avx,f16c")))
+static void loadHalfF16c(const uint16_t* src, float* dst, int count) {
+  int i = 0;
+  for (; i + 8 <= count; i += 8) _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + i))));
+  for (; i < count; ++i) dst[i] = halfToFloat(src[i]);
+}
+
+__attribute__((target("avx,f16c")))
+static void storeHalfF16c(const float* src, uint16_t* dst, int count) {
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    _mm_storeu_si128((__m128i*)(dst + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+  }
+  for (; i < count; ++i) dst[i] = floatToHalf(src[i]);
+}
+#endif
+
+// n RGBA pixels of depth to float.
+static void loadRow(OFX::BitDepthEnum depth, const void* src, float* dst, int n) {
+  const int count = 4 * n;
+  switch (depth) {
+  case OFX::eBitDepthUByte: {
+    const uint8_t* s = (const uint8_t*)src;
+    for (int i = 0; i < count; ++i) dst[i] = (float)s[i] * (1.0f / 255.0f);
+    break;
+  }
+  case OFX::eBitDepthUShort: {
+    const uint16_t* s = (const uint16_t*)src;
+    for (int i = 0; i < count; ++i) dst[i] = (float)s[i] * (1.0f / 65535.0f);
+    break;
+  }
+  case OFX::eBitDepthHalf: {
+    const uint16_t* s = (const uint16_t*)src;
+#ifdef SPLITTONE_X86_DISPATCH
+    if (cpuHasF16c()) {
+      loadHalfF16c(s, dst, count);
+      break;
+    }
+#endif
+    for (int i = 0; i < count; ++i) dst[i] = halfToFloat(s[i]);
+    break;
+  }
+  default:
+    std::memcpy(dst, src, (std::size_t)count * sizeof(float));
+    break;
+  }
+}
+
+// Integer depths clamp to [0, 1] (NaN to 0) and round to nearest.
+static inline float unitClamp(float v) { return v > 0.0f ? (v < 1.0f ? v : 1.0f) : 0.0f; }
+
+// n float RGBA pixels to depth.
+static void storeRow(OFX::BitDepthEnum depth, const float* src, void* dst, int n) {
+  const int count = 4 * n;
+  switch (depth) {
+  case OFX::eBitDepthUByte: {
+    uint8_t* d = (uint8_t*)dst;
+    for (int i = 0; i < count; ++i) d[i] = (uint8_t)(unitClamp(src[i]) * 255.0f + 0.5f);
+    break;
+  }
+  case OFX::eBitDepthUShort: {
+    uint16_t* d = (uint16_t*)dst;
+    for (int i = 0; i < count; ++i) d[i] = (uint16_t)(unitClamp(src[i]) * 65535.0f + 0.5f);
+    break;
+  }
+  case OFX::eBitDepthHalf: {
+    uint16_t* d = (uint16_t*)dst;
+#ifdef SPLITTONE_X86_DISPATCH
+    if (cpuHasF16c()) {
+      storeHalfF16c(src, d, count);
+      break;
+    }
+#endif
+    for (int i = 0; i < count; ++i) d[i] = floatToHalf(src[i]);
+    break;
+  }
+  default:
+    std::memcpy(dst, src, (std::size_t)count * sizeof(float));
+    break;
+  }
+}
+
+// Output dither
+// Review media delivered at 8 or 10 bits usually get a quantize/dither pass after the grade. With
+// Output Dither on, the store that writes each graded row quantizes color to the target levels
+// instead, adding a threshold from a small pattern tiled over absolute image coordinates, so the
+// result does not depend on render windows or threads. Alpha is stored as usual.
+enum DitherMode {
+  kDitherOff = 0,
+  kDitherOrdered = 1,   // 8x8 Bayer matrix
+  kDitherBlueNoise = 2  // 64x64 void-and-cluster pattern
+};
+
+static const int kBayerSize = 8;
+static const int kBlueNoiseSize = 64;
+
+// Ranks 0..size*size-1 of a void-and-cluster blue-noise pattern on a size x size torus (Ulichney
+// 1993), size a power of two. The Gaussian energy filter (sigma 1.5) is evaluated with portablePowf
+// and the initial pattern comes from a fixed-seed xorshift, so every machine builds the same ranks.
+static std::vector<int> voidAndClusterRanks(int size) {
+  const int n = size * size;
+  const int mask = size - 1;
+  std::vector<float> weight((std::size_t)n);
+  for (int dy = 0; dy < size; ++dy) {
+    for (int dx = 0; dx < size; ++dx) {
+      const int ox = std::min(dx, size - dx), oy = std::min(dy, size - dy);
+      weight[(std::size_t)(dy * size + dx)] = portablePowf(0.5f, (float)(ox * ox + oy * oy) * 0.3205980f); // exp(-d2 / 4.5)
+    }
+  }
+
+  std::vector<uint8_t> on((std::size_t)n, 0);
+  std::vector<float> energy((std::size_t)n, 0.0f);
+  auto toggle = [&](int idx, float sign) {
+    on[(std::size_t)idx] ^= 1;
+    const int px = idx & mask, py = idx / size;
+    for (int y = 0; y < size; ++y) {
+      const float* w = weight.data() + (std::size_t)(((y - py) & mask) * size);
+      float* e = energy.data() + (std::size_t)(y * size);
+      for (int x = 0; x < size; ++x) e[x] += sign * w[(x - px) & mask];
+    }
+  };
+  // Set pixel with the most energy around it, or unset pixel with the least; first index on ties.
+  auto tightestCluster = [&]() {
+    int best = -1;
+    for (int i = 0; i < n; ++i) if (on[(std::size_t)i] && (best < 0 || energy[(std::size_t)i] > energy[(std::size_t)best])) best = i;
+    return best;
+  };
+  auto largestVoid = [&]() {
+    int best = -1;
+    for (int i = 0; i < n; ++i) if (!on[(std::size_t)i] && (best < 0 || energy[(std::size_t)i] < energy[(std::size_t)best])) best = i;
+    return best;
+  };
+
+  // Initial pattern: a tenth of the pixels, spread out by moving the tightest cluster into the
+  // largest void until that no longer changes anything.
+  const int initial = n / 10;
+  uint32_t rng = 2463534242u; // xorshift32
+  for (int ones = 0; ones < initial;) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    const int idx = (int)(rng % (uint32_t)n);
+    if (!on[(std::size_t)idx]) {
+      toggle(idx, 1.0f);
+      ++ones;
+    }
+  }
+  for (;;) {
+    const int cluster = tightestCluster();
+    toggle(cluster, -1.0f);
+    const int hole = largestVoid();
+    toggle(hole, 1.0f);
+    if (hole == cluster) break;
+  }
+  const std::vector<uint8_t> prototype = on;
+  const std::vector<float> prototypeEnergy = energy;
+
+  // Ranks below the prototype come from removing tightest clusters, the rest from filling the
+  // largest voids (which past half full is the same as Ulichney's inverted clusters).
+  std::vector<int> rank((std::size_t)n, 0);
+  for (int ones = initial; ones > 0;) {
+    const int cluster = tightestCluster();
+    toggle(cluster, -1.0f);
+    rank[(std::size_t)cluster] = --ones;
+  }
+  on = prototype;
+  energy = prototypeEnergy;
+  for (int ones = initial; ones < n; ++ones) {
+    const int hole = largestVoid();
+    toggle(hole, 1.0f);
+    rank[(std::size_t)hole] = ones;
+  }
+  return rank;
+}
+
+// Thresholds in (-0.5, 0.5), size x size row-major.
+static const float* ditherPattern(int mode, int& size) {
+  static const std::vector<float> bayer = [] {
+    // Recursive Bayer construction: M(2k) = 4 M(k) + [[0, 2], [3, 1]].
+    std::vector<int> m(1, 0);
+    for (int k = 1; k < kBayerSize; k *= 2) {
+      std::vector<int> next((std::size_t)(4 * k * k));
+      static const int offset[2][2] = {{0, 2}, {3, 1}};
+      for (int y = 0; y < 2 * k; ++y) {
+        for (int x = 0; x < 2 * k; ++x) next[(std::size_t)(y * 2 * k + x)] = 4 * m[(std::size_t)((y % k) * k + x % k)] + offset[y / k][x / k];
+      }
+      m.swap(next);
+    }
+    std::vector<float> t(m.size());
+    for (std::size_t i = 0; i < m.size(); ++i) t[i] = ((float)m[i] + 0.5f) / (float)m.size() - 0.5f;
+    return t;
+  }();
+  static const std::vector<float> blueNoise = [] {
+    const std::vector<int> ranks = voidAndClusterRanks(kBlueNoiseSize);
+    std::vector<float> t(ranks.size());
+    for (std::size_t i = 0; i < ranks.size(); ++i) t[i] = ((float)ranks[i] + 0.5f) / (float)ranks.size() - 0.5f;
+    return t;
+  }();
+  size = mode == kDitherBlueNoise ? kBlueNoiseSize : kBayerSize;
+  return mode == kDitherBlueNoise ? blueNoise.data() : bayer.data();
+}
+
+struct DitherSetup {
+  int mode = kDitherOff;
+  int bits = 8;               // target levels 2^bits - 1; 8-bit outputs always use 8
+  const float* pattern = nullptr;
+  int size = 0;
+};
+
+static inline DitherSetup getDitherAtTime(OFX::ChoiceParam* mode, OFX::ChoiceParam* bits, double time) {
+  DitherSetup d;
+  mode->getValueAtTime(time, d.mode);
+  if (d.mode == kDitherOff) return d;
+  int b = 0;
+  bits->getValueAtTime(time, b);
+  d.bits = b == 1 ? 10 : 8;
+  d.pattern = ditherPattern(d.mode, d.size);
+  return d;
+}
+
+// storeRow with color quantized to d.bits levels; pixel i sits at image coordinates (x + i, y).
+// Integer outputs get the level directly (16-bit scaled to full range), half and float outputs
+// level / (2^bits - 1).
+static void storeRowDithered(const DitherSetup& d, OFX::BitDepthEnum depth, const float* src, void* dst, int n,
+                             int x, int y) {
+  const int bits = depth == OFX::eBitDepthUByte ? 8 : d.bits;
+  const int maxLevel = (1 << bits) - 1;
+  const float levels = (float)maxLevel;
+  const int mask = d.size - 1; // pattern sizes are powers of two
+  const float* row = d.pattern + (std::size_t)(y & mask) * (std::size_t)d.size;
+  auto level = [&](float v, int i) {
+    const int k = (int)(unitClamp(v) * levels + 0.5f + row[(x + i) & mask]);
+    return std::min(k, maxLevel);
+  };
+
+  for (int i = 0; i < n; ++i, src += 4) {
+    const float a = src[3];
+    switch (depth) {
+    case OFX::eBitDepthUByte: {
+      uint8_t* o = (uint8_t*)dst + 4 * (std::size_t)i;
+      for (int ch = 0; ch < 3; ++ch) o[ch] = (uint8_t)level(src[ch], i);
+      o[3] = (uint8_t)(unitClamp(a) * 255.0f + 0.5f);
+      break;
+    }
+    case OFX::eBitDepthUShort: {
+      uint16_t* o = (uint16_t*)dst + 4 * (std::size_t)i;
+      for (int ch = 0; ch < 3; ++ch) o[ch] = (uint16_t)(((uint32_t)level(src[ch], i) * 65535u + (uint32_t)maxLevel / 2) / (uint32_t)maxLevel);
+      o[3] = (uint16_t)(unitClamp(a) * 65535.0f + 0.5f);
+      break;
+    }
+    case OFX::eBitDepthHalf: {
+      uint16_t* o = (uint16_t*)dst + 4 * (std::size_t)i;
+      for (int ch = 0; ch < 3; ++ch) o[ch] = floatToHalf((float)level(src[ch], i) / levels);
+      o[3] = floatToHalf(a);
+      break;
+    }
+    default: {
+      float* o = (float*)dst + 4 * (std::size_t)i;
+      for (int ch = 0; ch < 3; ++ch) o[ch] = (float)level(src[ch], i) / levels;
+      o[3] = a;
+      break;
+    }
+    }
+  }
+}
+
+// True when applyCurve(x) is a plain passthrough (no pow evaluated).
+static inline bool isLinearZone(float x, float shadowEnd, float highlightStart) {
+  x = std::max(0.0f, x);
+  return x > 1.0f || (x > shadowEnd && x <= highlightStart) || (x <= shadowEnd && shadowEnd <= 0.0f);
+}
+
+enum KernelMode {
+  kKernelReference = 0, // scalar std::pow, identical to the DCTL math
+  kKernelFast = 1       // SoA SIMD kernels with a polynomial pow (< 1e-6 absolute error)
+};
+
+struct ParamsSnapshot {
+  int preset = 9;               // default matches DCTL (DaVinci Intermediate)
+  float preserveMidgray = 0.0f; // 0..1
+  float pShadow[3] = {1,1,1};   // R,G,B
+  float pHighlight[3] = {1,1,1};
+  bool burnInCurve = false;     // overlay drawn into the rendered pixels
+  bool deterministic = false;   // portable pow only: identical bits on every CPU / SIMD width
+  int kernel = kKernelReference;
+};
+
+static inline ParamsSnapshot getParamsAtTime(OFX::ChoiceParam* preset,
+                                             OFX::DoubleParam* preserve,
+                                             OFX::DoubleParam* p1,
+                                             OFX::DoubleParam* p2,
+                                             OFX::DoubleParam* p3,
+                                             OFX::DoubleParam* p4,
+                                             OFX::DoubleParam* p5,
+                                             OFX::DoubleParam* p6,
+                                             OFX::BooleanParam* burnInCurve,
+                                             OFX::BooleanParam* deterministic,
+                                             OFX::ChoiceParam* kernel,
+                                             double time) {
+  ParamsSnapshot s;
+  preset->getValueAtTime(time, s.preset);
+
+  double v = 0;
+  preserve->getValueAtTime(time, v);
+  s.preserveMidgray = (float)v;
+
+  p1->getValueAtTime(time, v); s.pShadow[0] = (float)v;
+  p2->getValueAtTime(time, v); s.pShadow[1] = (float)v;
+  p3->getValueAtTime(time, v); s.pShadow[2] = (float)v;
+
+  p4->getValueAtTime(time, v); s.pHighlight[0] = (float)v;
+  p5->getValueAtTime(time, v); s.pHighlight[1] = (float)v;
+  p6->getValueAtTime(time, v); s.pHighlight[2] = (float)v;
+
+  bool b = false;
+  burnInCurve->getValueAtTime(time, b);
+  s.burnInCurve = b;
+
+  deterministic->getValueAtTime(time, b);
+  s.deterministic = b;
+
+  kernel->getValueAtTime(time, s.kernel);
+
+  return s;
+}
+
+// Curve boundaries and per-channel exponents, resolved once per render.
+struct CurveSetup {
+  float midGray = 0.0f;
+  float shadowEnd = 0.0f;
+  float highlightStart = 0.0f;
+  float pShadow[3] = {1,1,1};
+  float pHighlight[3] = {1,1,1};
+};
+
+static inline CurveSetup makeCurveSetup(const ParamsSnapshot& p) {
+  // Compute boundaries (same as DCTL)
+  CurveSetup c;
+  c.midGray = getMiddleGray(p.preset);
+  const float gapDist = c.midGray * p.preserveMidgray;
+  c.shadowEnd = std::max(0.0f, c.midGray - gapDist);
+  c.highlightStart = std::min(1.0f, c.midGray + gapDist);
+  for (int i = 0; i < 3; ++i) {
+    c.pShadow[i] = p.pShadow[i];
+    c.pHighlight[i] = p.pHighlight[i];
+  }
+  return c;
+}
+
+// Wedge contact sheet: count variants of the grade, spreading one parameter group evenly from
+// -spread to +spread around its current value, tiled over the output.
+enum WedgeTarget {
+  kWedgeShadow = 0,
+  kWedgeHighlight = 1,
+  kWedgePreserve = 2
+};
+
+static const int kMaxWedgeCount = 16;
+
+struct WedgeSetup {
+  int count = 0; // 0 when wedge mode is off
+  int target = kWedgeShadow;
+  float spread = 0.5f;
+};
+
+static inline WedgeSetup getWedgeAtTime(OFX::BooleanParam* enabled,
+                                        OFX::IntParam* count,
+                                        OFX::ChoiceParam* target,
+                                        OFX::DoubleParam* spread,
+                                        double time) {
+  WedgeSetup w;
+  bool on = false;
+  enabled->getValueAtTime(time, on);
+  if (!on) return w;
+  count->getValueAtTime(time, w.count);
+  w.count = std::max(2, std::min(kMaxWedgeCount, w.count));
+  target->getValueAtTime(time, w.target);
+  double v = 0;
+  spread->getValueAtTime(time, v);
+  w.spread = (float)v;
+  return w;
+}
+
+// Variant k of w.count; with an odd count the middle one is the current grade.
+static inline CurveSetup makeWedgeVariant(const ParamsSnapshot& p, const WedgeSetup& w, int k) {
+  ParamsSnapshot q = p;
+  const float offset = w.spread * (2.0f * (float)k / (float)(w.count - 1) - 1.0f);
+  for (int i = 0; i < 3; ++i) {
+    if (w.target == kWedgeShadow) q.pShadow[i] = clampf(p.pShadow[i] + offset, 0.2f, 2.0f);
+    if (w.target == kWedgeHighlight) q.pHighlight[i] = clampf(p.pHighlight[i] + offset, 0.2f, 2.0f);
+  }
+  if (w.target == kWedgePreserve) q.preserveMidgray = clampf(p.preserveMidgray + offset, 0.0f, 1.0f);
+  return makeCurveSetup(q);
+}
+
+// Row kernels take n interleaved RGBA float pixels (src may equal dst) and return how many pixels
+// stayed entirely in the linear zones.
+typedef int (*RowKernelFn)(const float* src, float* dst, int n, const CurveSetup& c);
+
+template <class Pow>
+static int processRow(const float* src, float* dst, int n, const CurveSetup& c) {
+  int linear = 0;
+  for (int i = 0; i < n; ++i, src += 4, dst += 4) {
+    const float r = src[0];
+    const float g = src[1];
+    const float b = src[2];
+    const float a = src[3];
+
+    linear += isLinearZone(r, c.shadowEnd, c.highlightStart) &&
+              isLinearZone(g, c.shadowEnd, c.highlightStart) &&
+              isLinearZone(b, c.shadowEnd, c.highlightStart);
+
+    dst[0] = applyCurveWith<Pow>(r, c.shadowEnd, c.highlightStart, c.pShadow[0], c.pHighlight[0]);
+    dst[1] = applyCurveWith<Pow>(g, c.shadowEnd, c.highlightStart, c.pShadow[1], c.pHighlight[1]);
+    dst[2] = applyCurveWith<Pow>(b, c.shadowEnd, c.highlightStart, c.pShadow[2], c.pHighlight[2]);
+    dst[3] = a;
+  }
+  return linear;
+}
+
+// Exponent-specialized kernels
+// Most grades leave several of the six exponents at 1.0, where both pows return the ratio itself
+// (checked over every float in [0,1]; pow(x, 2) is not always x * x, so 2.0 is not special). Each
+// channel runs a kernel compiled for which of its two exponents are 1.0 and skips those pows
+// entirely. The kernels are picked once per row from the CurveSetup; output is bit-identical to
+// processRow<Pow>.
+template <class Pow, bool kIdentity>
+struct IdentityPow {
+  static float pow(float x, float p) { return kIdentity ? x : Pow::pow(x, p); }
+};
+
+typedef void (*ChannelKernelFn)(const float* src, float* dst, int n, const CurveSetup& c, int ch);
+
+// One channel of n interleaved RGBA pixels; src and dst are offset to the channel.
+template <class Pow, bool kShadowOne, bool kHighlightOne>
+static void processChannel(const float* src, float* dst, int n, const CurveSetup& c, int ch) {
+  typedef IdentityPow<Pow, kShadowOne> ShadowPow;
+  typedef IdentityPow<Pow, kHighlightOne> HighlightPow;
+  const float pShadow = c.pShadow[ch];
+  const float pHighlight = c.pHighlight[ch];
+  const float shadowEnd = c.shadowEnd;
+  const float highlightStart = c.highlightStart;
+  const float range = 1.0f - highlightStart;
+  for (int i = 0; i < n; ++i, src += 4, dst += 4) {
+    if (!kShadowOne && !kHighlightOne) {
+      dst[0] = applyCurveWith<ShadowPow, HighlightPow>(src[0], shadowEnd, highlightStart, pShadow, pHighlight);
+      continue;
+    }
+    // Identity zones are cheap enough to evaluate unconditionally and select, which avoids the
+    // mispredicted zone branches; the same operations as applyCurveWith keep the bits equal. Inside
+    // its zone a ratio is already in [0,1] (rounding is monotonic), so the clamps are dropped.
+    const float x = std::max(0.0f, src[0]);
+    float out = x;
+    if (kShadowOne) {
+      const float shadow = shadowEnd > 0.0f ? shadowEnd * (x / shadowEnd) : x;
+      out = x <= shadowEnd ? shadow : out;
+    } else if (x <= shadowEnd) {
+      out = applyCurveWith<ShadowPow, HighlightPow>(x, shadowEnd, highlightStart, pShadow, pHighlight);
+    }
+    if (kHighlightOne) {
+      const float highlight = range > 0.0f ? highlightStart + range * ((x - highlightStart) / range) : x;
+      out = (x > highlightStart) & (x <= 1.0f) ? highlight : out;
+    } else if (x > highlightStart && x <= 1.0f) {
+      out = applyCurveWith<ShadowPow, HighlightPow>(x, shadowEnd, highlightStart, pShadow, pHighlight);
+    }
+    dst[0] = out;
+  }
+}
+
+template <class Pow>
+static ChannelKernelFn specializedChannel(float pShadow, float pHighlight) {
+  static const ChannelKernelFn kernels[2][2] = {
+    {processChannel<Pow, false, false>, processChannel<Pow, false, true>},
+    {processChannel<Pow, true, false>, processChannel<Pow, true, true>}
+  };
+  return kernels[pShadow == 1.0f][pHighlight == 1.0f];
+}
+
+template <class Pow>
+static int processRowSpecialized(const float* src, float* dst, int n, const CurveSetup& c) {
+  bool anyOne = false;
+  for (int ch = 0; ch < 3; ++ch) anyOne = anyOne || c.pShadow[ch] == 1.0f || c.pHighlight[ch] == 1.0f;
+  if (!anyOne) return processRow<Pow>(src, dst, n, c);
+
+  // Zones and alpha first: with src == dst the channel passes overwrite the inputs.
+  int linear = 0;
+  for (int i = 0; i < n; ++i) {
+    const float* s = src + (std::size_t)i * 4;
+    linear += isLinearZone(s[0], c.shadowEnd, c.highlightStart) &&
+              isLinearZone(s[1], c.shadowEnd, c.highlightStart) &&
+              isLinearZone(s[2], c.shadowEnd, c.highlightStart);
+    dst[(std::size_t)i * 4 + 3] = s[3];
+  }
+  for (int ch = 0; ch < 3; ++ch) {
+    specializedChannel<Pow>(c.pShadow[ch], c.pHighlight[ch])(src + ch, dst + ch, n, c, ch);
+  }
+  return linear;
+}
+
+static int processRowScalarSpecialized(const float* src, float* dst, int n, const CurveSetup& c) {
+  return processRowSpecialized<StdPow>(src, dst, n, c);
+}
+
+static int processRowDeterministicSpecialized(const float* src, float* dst, int n, const CurveSetup& c) {
+  return processRowSpecialized<PortablePow>(src, dst, n, c);
+}
+
+// Fast kernels: tile-level AoS -> SoA staging
+// A tile of up to kSoATile pixels is transposed into R, G and B planes on the stack (3 KB, stays
+// in L1), each plane runs a branchless kernel with its channel's exponents as uniform scalars, and
+// the planes are interleaved back on store. The plane kernel is written once against a "lane" type
+// (scalar, SSE2, AVX2, AVX-512) so the same sequence of IEEE float operations runs on every width;
+// on x86 the AVX2 and AVX-512 builds are picked at runtime.
+//
+// Without FMA every width gives identical bits (that is what deterministic mode uses). The FMA
+// builds are slightly faster and more accurate but only reproducible on CPUs with FMA.
+static const int kSoATile = 256;
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SPLITTONE_FORCE_INLINE __forceinline
+#else
+#define SPLITTONE_FORCE_INLINE inline __attribute__((always_inline))
+#endif
+
+// Lanes. select(m, a, b) is m ? a : b; min/max follow minps/maxps (the second operand wins on
+// NaN), which the scalar lane spells out so that it matches the vector ones bit for bit.
+template <bool kFma>
+struct LaneScalar {
+  typedef float F;
+  typedef int32_t I;
+  typedef bool M;
+  static const int kWidth = 1;
+  static const bool kFused = kFma;
+
+  static SPLITTONE_FORCE_INLINE F load(const float* p) { return *p; }
+  static SPLITTONE_FORCE_INLINE void store(float* p, F v) { *p = v; }
+  static SPLITTONE_FORCE_INLINE void storeLinear(int32_t* p, M curved) { *p = curved ? 0 : 1; }
+  static SPLITTONE_FORCE_INLINE F splat(float v) { return v; }
+  static SPLITTONE_FORCE_INLINE I splati(int32_t v) { return v; }
+  static SPLITTONE_FORCE_INLINE F add(F a, F b) { return a + b; }
+  static SPLITTONE_FORCE_INLINE F sub(F a, F b) { return a - b; }
+  static SPLITTONE_FORCE_INLINE F mul(F a, F b) { return a * b; }
+  static SPLITTONE_FORCE_INLINE F div(F a, F b) { return a / b; }
+  static SPLITTONE_FORCE_INLINE F madd(F a, F b, F c) { return kFma ? std::fma(a, b, c) : a * b + c; }
+  static SPLITTONE_FORCE_INLINE F min(F a, F b) { return a < b ? a : b; }
+  static SPLITTONE_FORCE_INLINE F max(F a, F b) { return a > b ? a : b; }
+  static SPLITTONE_FORCE_INLINE M lt(F a, F b) { return a < b; }
+  static SPLITTONE_FORCE_INLINE M gt(F a, F b) { return a > b; }
+  static SPLITTONE_FORCE_INLINE M ge(F a, F b) { return a >= b; }
+  static SPLITTONE_FORCE_INLINE M gti(I a, I b) { return a > b; }
+  static SPLITTONE_FORCE_INLINE M lei(I a, I b) { return a <= b; }
+  static SPLITTONE_FORCE_INLINE M andMask(M a, M b) { return a & b; }
+  static SPLITTONE_FORCE_INLINE M orMask(M a, M b) { return a | b; }
+  static SPLITTONE_FORCE_INLINE M andNotMask(M a, M b) { return !a & b; }
+  static SPLITTONE_FORCE_INLINE F select(M m, F a, F b) { return m ? a : b; }
+  static SPLITTONE_FORCE_INLINE I selecti(M m, I a, I b) { return m ? a : b; }
+  static SPLITTONE_FORCE_INLINE I bits(F v) { I i; std::memcpy(&i, &v, sizeof(i)); return i; }
+  static SPLITTONE_FORCE_INLINE F fromBits(I i) { F v; std::memcpy(&v, &i, sizeof(v)); return v; }
+  static SPLITTONE_FORCE_INLINE I addi(I a, I b) { return (I)((uint32_t)a + (uint32_t)b); }
+  static SPLITTONE_FORCE_INLINE I subi(I a, I b) { return (I)((uint32_t)a - (uint32_t)b); }
+  static SPLITTONE_FORCE_INLINE I andi(I a, I b) { return a & b; }
+  static SPLITTONE_FORCE_INLINE I ori(I a, I b) { return a | b; }
+  static SPLITTONE_FORCE_INLINE I shr23(I a) { return (I)((uint32_t)a >> 23); }
+  static SPLITTONE_FORCE_INLINE I shl23(I a) { return (I)((uint32_t)a << 23); }
+  static SPLITTONE_FORCE_INLINE I trunc(F v) { return (I)v; }
+  static SPLITTONE_FORCE_INLINE F toFloat(I i) { return (F)i; }
+};
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SPLITTONE_HAVE_SSE2 1
+
+struct LaneSse2 {
+  typedef __m128 F;
+  typedef __m128i I;
+  typedef __m128 M;
+  static const int kWidth = 4;
+  static const bool kFused = false;
+
+  static SPLITTONE_FORCE_INLINE F load(const float* p) { return _mm_loadu_ps(p); }
+  static SPLITTONE_FORCE_INLINE void store(float* p, F v) { _mm_storeu_ps(p, v); }
+  static SPLITTONE_FORCE_INLINE void storeLinear(int32_t* p, M curved) {
+    _mm_storeu_si128((__m128i*)p, _mm_andnot_si128(_mm_castps_si128(curved), _mm_set1_epi32(1)));
+  }
+  static SPLITTONE_FORCE_INLINE F splat(float v) { return _mm_set1_ps(v); }
+  static SPLITTONE_FORCE_INLINE I splati(int32_t v) { return _mm_set1_epi32(v); }
+  static SPLITTONE_FORCE_INLINE F add(F a, F b) { return _mm_add_ps(a, b); }
+  static SPLITTONE_FORCE_INLINE F sub(F a, F b) { return _mm_sub_ps(a, b); }
+  static SPLITTONE_FORCE_INLINE F mul(F a, F b) { return _mm_mul_ps(a, b); }
+  static SPLITTONE_FORCE_INLINE F div(F a, F b) { return _mm_div_ps(a, b); }
+  static SPLITTONE_FORCE_INLINE F madd(F a, F b, F c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+  static SPLITTONE_FORCE_INLINE F min(F a, F b) { return _mm_min_ps(a, b); }
+  static SPLITTONE_FORCE_INLINE F max(F a, F b) { return _mm_max_ps(a, b); }
+  static SPLITTONE_FORCE_INLINE M lt(F a, F b) { return _mm_cmplt_ps(a, b); }
+  static SPLITTONE_FORCE_INLINE M gt(F a, F b) { return _mm_cmpgt_ps(a, b); }
+  static SPLITTONE_FORCE_INLINE M ge(F a, F b) { return _mm_cmpge_ps(a, b); }
+  static SPLITTONE_FORCE_INLINE M gti(I a, I b) { return _mm_castsi128_ps(_mm_cmpgt_epi32(a, b)); }
+  static SPLITTONE_FORCE_INLINE M lei(I a, I b) { return _mm_andnot_ps(gti(a, b), _mm_castsi128_ps(_mm_set1_epi32(-1))); }
+  static SPLITTONE_FORCE_INLINE M andMask(M a, M b) { return _mm_and_ps(a, b); }
+  static SPLITTONE_FORCE_INLINE M orMask(M a, M b) { return _mm_or_ps(a, b); }
+  static SPLITTONE_FORCE_INLINE M andNotMask(M a, M b) { return _mm_andnot_ps(a, b); }
+  static SPLITTONE_FORCE_INLINE F select(M m, F a, F b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+  static SPLITTONE_FORCE_INLINE I selecti(M m, I a, I b) { return bits(select(m, fromBits(a), fromBits(b))); }
+  static SPLITTONE_FORCE_INLINE I bits(F v) { return _mm_castps_si128(v); }
+  static SPLITTONE_FORCE_INLINE F fromBits(I i) { return _mm_castsi128_ps(i); }
+  static SPLITTONE_FORCE_INLINE I addi(I a, I b) { return _mm_add_epi32(a, b); }
+  static SPLITTONE_FORCE_INLINE I subi(I a, I b) { return _mm_sub_epi32(a, b); }
+  static SPLITTONE_FORCE_INLINE I andi(I a, I b) { return _mm_and_si128(a, b); }
+  static SPLITTONE_FORCE_INLINE I ori(I a, I b) { return _mm_or_si128(a, b); }
+  static SPLITTONE_FORCE_INLINE I shr23(I a) { return _mm_srli_epi32(a, 23); }
+  static SPLITTONE_FORCE_INLINE I shl23(I a) { return _mm_slli_epi32(a, 23); }
+  static SPLITTONE_FORCE_INLINE I trunc(F v) { return _mm_cvttps_epi32(v); }
+  static SPLITTONE_FORCE_INLINE F toFloat(I i) { return _mm_cvtepi32_ps(i); }
+};
+#endif
+
+#ifdef SPLITTONE_X86_DISPATCH
+// The AVX lanes carry their target attribute; they are plain inline (GCC rejects always_inline
+// across a target mismatch) and get inlined once the kernel lands in its target-attributed entry.
+#define SPLITTONE_AVX2 __attribute__((target("avx2,fma"))) inline
+#define SPLITTONE_AVX512 __attribute__((target("avx512f,avx512vl,avx512bw,avx512dq"))) inline
+
+template <bool kFma>
+struct LaneAvx2 {
+  typedef __m256 F;
+  typedef __m256i I;
+  typedef __m256 M;
+  static const int kWidth = 8;
+  static const bool kFused = kFma;
+
+  static SPLITTONE_AVX2 F load(const float* p) { return _mm256_loadu_ps(p); }
+  static SPLITTONE_AVX2 void store(float* p, F v) { _mm256_storeu_ps(p, v); }
+  static SPLITTONE_AVX2 void storeLinear(int32_t* p, M curved) {
+    _mm256_storeu_si256((__m256i*)p, _mm256_andnot_si256(_mm256_castps_si256(curved), _mm256_set1_epi32(1)));
+  }
+  static SPLITTONE_AVX2 F splat(float v) { return _mm256_set1_ps(v); }
+  static SPLITTONE_AVX2 I splati(int32_t v) { return _mm256_set1_epi32(v); }
+  static SPLITTONE_AVX2 F add(F a, F b) { return _mm256_add_ps(a, b); }
+  static SPLITTONE_AVX2 F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+  static SPLITTONE_AVX2 F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+  static SPLITTONE_AVX2 F div(F a, F b) { return _mm256_div_ps(a, b); }
+  static SPLITTONE_AVX2 F madd(F a, F b, F c) {
+    return kFma ? _mm256_fmadd_ps(a, b, c) : _mm256_add_ps(_mm256_mul_ps(a, b), c);
+  }
+  static SPLITTONE_AVX2 F min(F a, F b) { return _mm256_min_ps(a, b); }
+  static SPLITTONE_AVX2 F max(F a, F b) { return _mm256_max_ps(a, b); }
+  static SPLITTONE_AVX2 M lt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+  static SPLITTONE_AVX2 M gt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+  static SPLITTONE_AVX2 M ge(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+  static SPLITTONE_AVX2 M gti(I a, I b) { return _mm256_castsi256_ps(_mm256_cmpgt_epi32(a, b)); }
+  static SPLITTONE_AVX2 M lei(I a, I b) { return _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_add_epi32(b, _mm256_set1_epi32(1)), a)); }
+  static SPLITTONE_AVX2 M andMask(M a, M b) { return _mm256_and_ps(a, b); }
+  static SPLITTONE_AVX2 M orMask(M a, M b) { return _mm256_or_ps(a, b); }
+  static SPLITTONE_AVX2 M andNotMask(M a, M b) { return _mm256_andnot_ps(a, b); }
+  static SPLITTONE_AVX2 F select(M m, F a, F b) { return _mm256_blendv_ps(b, a, m); }
+  static SPLITTONE_AVX2 I selecti(M m, I a, I b) { return bits(_mm256_blendv_ps(fromBits(b), fromBits(a), m)); }
+  static SPLITTONE_AVX2 I bits(F v) { return _mm256_castps_si256(v); }
+  static SPLITTONE_AVX2 F fromBits(I i) { return _mm256_castsi256_ps(i); }
+  static SPLITTONE_AVX2 I addi(I a, I b) { return _mm256_add_epi32(a, b); }
+  static SPLITTONE_AVX2 I subi(I a, I b) { return _mm256_sub_epi32(a, b); }
+  static SPLITTONE_AVX2 I andi(I a, I b) { return _mm256_and_si256(a, b); }
+  static SPLITTONE_AVX2 I ori(I a, I b) { return _mm256_or_si256(a, b); }
+  static SPLITTONE_AVX2 I shr23(I a) { return _mm256_srli_epi32(a, 23); }
+  static SPLITTONE_AVX2 I shl23(I a) { return _mm256_slli_epi32(a, 23); }
+  static SPLITTONE_AVX2 I trunc(F v) { return _mm256_cvttps_epi32(v); }
+  static SPLITTONE_AVX2 F toFloat(I i) { return _mm256_cvtepi32_ps(i); }
+};
+
+template <bool kFma>
+struct LaneAvx512 {
+  typedef __m512 F;
+  typedef __m512i I;
+  typedef __mmask16 M;
+  static const int kWidth = 16;
+  static const bool kFused = kFma;
+  // Full-mask merge forms: the unmasked intrinsics start from _mm512_undefined_*, which trips
+  // -Wmaybe-uninitialized in GCC 12's headers.
+  static const __mmask16 kAll = 0xffff;
+
+  static SPLITTONE_AVX512 F load(const float* p) { return _mm512_loadu_ps(p); }
+  static SPLITTONE_AVX512 void store(float* p, F v) { _mm512_storeu_ps(p, v); }
+  static SPLITTONE_AVX512 void storeLinear(int32_t* p, M curved) {
+    _mm512_storeu_si512(p, _mm512_maskz_mov_epi32((__mmask16)~curved, _mm512_set1_epi32(1)));
+  }
+  static SPLITTONE_AVX512 F splat(float v) { return _mm512_set1_ps(v); }
+  static SPLITTONE_AVX512 I splati(int32_t v) { return _mm512_set1_epi32(v); }
+  static SPLITTONE_AVX512 F add(F a, F b) { return _mm512_add_ps(a, b); }
+  static SPLITTONE_AVX512 F sub(F a, F b) { return _mm512_sub_ps(a, b); }
+  static SPLITTONE_AVX512 F mul(F a, F b) { return _mm512_mul_ps(a, b); }
+  static SPLITTONE_AVX512 F div(F a, F b) { return _mm512_div_ps(a, b); }
+  static SPLITTONE_AVX512 F madd(F a, F b, F c) {
+    return kFma ? _mm512_fmadd_ps(a, b, c) : _mm512_add_ps(_mm512_mul_ps(a, b), c);
+  }
+  static SPLITTONE_AVX512 F min(F a, F b) { return _mm512_mask_min_ps(a, kAll, a, b); }
+  static SPLITTONE_AVX512 F max(F a, F b) { return _mm512_mask_max_ps(a, kAll, a, b); }
+  static SPLITTONE_AVX512 M lt(F a, F b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+  static SPLITTONE_AVX512 M gt(F a, F b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+  static SPLITTONE_AVX512 M ge(F a, F b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+  static SPLITTONE_AVX512 M gti(I a, I b) { return _mm512_cmpgt_epi32_mask(a, b); }
+  static SPLITTONE_AVX512 M lei(I a, I b) { return _mm512_cmple_epi32_mask(a, b); }
+  static SPLITTONE_AVX512 M andMask(M a, M b) { return (M)(a & b); }
+  static SPLITTONE_AVX512 M orMask(M a, M b) { return (M)(a | b); }
+  static SPLITTONE_AVX512 M andNotMask(M a, M b) { return (M)(~a & b); }
+  static SPLITTONE_AVX512 F select(M m, F a, F b) { return _mm512_mask_blend_ps(m, b, a); }
+  static SPLITTONE_AVX512 I selecti(M m, I a, I b) { return _mm512_mask_blend_epi32(m, b, a); }
+  static SPLITTONE_AVX512 I bits(F v) { return _mm512_castps_si512(v); }
+  static SPLITTONE_AVX512 F fromBits(I i) { return _mm512_castsi512_ps(i); }
+  static SPLITTONE_AVX512 I addi(I a, I b) { return _mm512_add_epi32(a, b); }
+  static SPLITTONE_AVX512 I subi(I a, I b) { return _mm512_sub_epi32(a, b); }
+  static SPLITTONE_AVX512 I andi(I a, I b) { return _mm512_and_si512(a, b); }
+  static SPLITTONE_AVX512 I ori(I a, I b) { return _mm512_or_si512(a, b); }
+  static SPLITTONE_AVX512 I shr23(I a) { return _mm512_mask_srli_epi32(a, kAll, a, 23); }
+  static SPLITTONE_AVX512 I shl23(I a) { return _mm512_mask_slli_epi32(a, kAll, a, 23); }
+  static SPLITTONE_AVX512 I trunc(F v) { return _mm512_mask_cvttps_epi32(bits(v), kAll, v); }
+  static SPLITTONE_AVX512 F toFloat(I i) { return _mm512_mask_cvtepi32_ps(fromBits(i), kAll, i); }
+};
+#endif
+
+// The generic kernels below have no target of their own and only ever run inlined into an entry
+// point built for their lane's target, so GCC's vector-ABI note does not apply to them.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+// out = pow(r, p) for r in [0,1] as exp2(p * log2(r)) in float; ~2e-7 relative error.
+template <class V>
+static SPLITTONE_FORCE_INLINE void fastPowLanes(const typename V::F& r, const typename V::F& p, typename V::F& out) {
+  typedef typename V::F F;
+  typedef typename V::I I;
+  typedef typename V::M M;
+  const F zero = V::splat(0.0f);
+  const F one = V::splat(1.0f);
+
+  // Bring denormals into the normal range before splitting off the exponent.
+  const M tiny = V::lt(r, V::splat(1.17549435e-38f));
+  const I rb = V::bits(V::select(tiny, V::mul(r, V::splat(16777216.0f)), r));
+  I e = V::subi(V::shr23(rb), V::selecti(tiny, V::splati(127 + 24), V::splati(127)));
+  F m = V::fromBits(V::ori(V::andi(rb, V::splati(0x007fffff)), V::splati(0x3f800000)));
+  const M high = V::gt(m, V::splat(1.41421356f));
+  m = V::select(high, V::mul(m, V::splat(0.5f)), m);
+  e = V::selecti(high, V::addi(e, V::splati(1)), e);
+
+  // log2(m) = 2/ln2 * atanh(s), s = (m-1)/(m+1)
+  const F s = V::div(V::sub(m, one), V::add(m, one));
+  const F s2 = V::mul(s, s);
+  F t = V::madd(s2, V::splat(1.0f / 9.0f), V::splat(1.0f / 7.0f));
+  t = V::madd(t, s2, V::splat(1.0f / 5.0f));
+  t = V::madd(t, s2, V::splat(1.0f / 3.0f));
+  t = V::madd(t, s2, one);
+  const F y = V::mul(p, V::madd(V::mul(V::splat(2.88539008f), s), t, V::toFloat(e)));
+
+  // 2^y = 2^k * e^(f*ln2), k = floor(y + 0.5)
+  const F yc = V::max(y, V::splat(-126.0f));
+  const F half = V::add(yc, V::splat(0.5f));
+  I k = V::trunc(half);
+  k = V::selecti(V::lt(half, V::toFloat(k)), V::subi(k, V::splati(1)), k);
+  const F f = V::mul(V::sub(yc, V::toFloat(k)), V::splat(0.693147181f));
+  F q = V::madd(f, V::splat(1.0f / 5040.0f), V::splat(1.0f / 720.0f));
+  q = V::madd(q, f, V::splat(1.0f / 120.0f));
+  q = V::madd(q, f, V::splat(1.0f / 24.0f));
+  q = V::madd(q, f, V::splat(1.0f / 6.0f));
+  q = V::madd(q, f, V::splat(0.5f));
+  q = V::madd(q, f, one);
+  q = V::madd(q, f, one);
+  const F result = V::mul(q, V::fromBits(V::shl23(V::addi(k, V::splati(127)))));
+
+  const F inRange = V::select(V::ge(y, V::splat(-126.0f)), result, zero);
+  out = V::select(V::gt(r, zero), inRange, zero);
+}
+
+struct PlaneSetup {
+  float shadowEnd, highlightStart, range, pShadow, pHighlight;
+  int32_t shadowEndBits, highlightStartBits;
+  bool shadowCurves; // shadowEnd > 0; otherwise the shadow zone is a passthrough
+};
+
+static inline PlaneSetup makePlaneSetup(float shadowEnd, float highlightStart, float pShadow, float pHighlight) {
+  PlaneSetup k;
+  k.shadowEnd = shadowEnd;
+  k.highlightStart = highlightStart;
+  k.range = 1.0f - highlightStart;
+  k.pShadow = pShadow;
+  k.pHighlight = pHighlight;
+  std::memcpy(&k.shadowEndBits, &shadowEnd, sizeof(k.shadowEndBits));
+  std::memcpy(&k.highlightStartBits, &highlightStart, sizeof(k.highlightStartBits));
+  k.shadowCurves = shadowEnd > 0.0f;
+  return k;
+}
+
+// V::kWidth values of one channel plane in place; linear[i] is set when the value took a
+// passthrough zone. Same zones as applyCurve, but every lane computes one ratio/exponent pair and
+// selects. Zone tests run on the bit patterns: for non-negative floats integer order is float
+// order, and NaN or negative inputs are folded to 0 first.
+template <class V>
+static SPLITTONE_FORCE_INLINE void curveLanes(float* x, int32_t* linear, const PlaneSetup& k) {
+  typedef typename V::F F;
+  typedef typename V::I I;
+  typedef typename V::M M;
+  const I xi = V::bits(V::load(x));
+  const M keep = V::andMask(V::gti(xi, V::splati(0)), V::lei(xi, V::splati(0x7f800000))); // (0, +inf]
+  const I vi = V::selecti(keep, xi, V::splati(0));
+  const F v = V::fromBits(vi);
+  const M inShadow = V::lei(vi, V::splati(k.shadowEndBits));
+  const M inHighlight = V::andMask(V::gti(vi, V::splati(k.highlightStartBits)), V::lei(vi, V::splati(0x3f800000)));
+  const M curvedLane = k.shadowCurves ? V::orMask(inShadow, inHighlight) : V::andNotMask(inShadow, inHighlight);
+
+  const F shadowEnd = V::splat(k.shadowEnd);
+  const F highlightStart = V::splat(k.highlightStart);
+  const F range = V::splat(k.range);
+  const F ratio = V::select(inShadow, V::div(v, shadowEnd), V::div(V::sub(v, highlightStart), range));
+  const F clamped = V::min(V::max(ratio, V::splat(0.0f)), V::splat(1.0f));
+  const F p = V::select(inShadow, V::splat(k.pShadow), V::splat(k.pHighlight));
+  F pw;
+  fastPowLanes<V>(clamped, p, pw);
+  const F curved = V::select(inShadow, V::mul(shadowEnd, pw), V::add(highlightStart, V::mul(range, pw)));
+
+  V::store(x, V::select(curvedLane, curved, v));
+  V::storeLinear(linear, curvedLane);
+}
+
+template <class V>
+static SPLITTONE_FORCE_INLINE void curvePlane(float* x, int32_t* linear, int n, const PlaneSetup& k) {
+  int i = 0;
+  for (; i + V::kWidth <= n; i += V::kWidth) curveLanes<V>(x + i, linear + i, k);
+  for (; i < n; ++i) curveLanes<LaneScalar<V::kFused> >(x + i, linear + i, k);
+}
+
+template <class V>
+static SPLITTONE_FORCE_INLINE int processRowSoABody(const float* src, float* dst, int n, const CurveSetup& c) {
+  alignas(64) float planes[3][kSoATile];
+  alignas(64) int32_t linear[3][kSoATile];
+  PlaneSetup setup[3];
+  for (int ch = 0; ch < 3; ++ch) {
+    setup[ch] = makePlaneSetup(c.shadowEnd, c.highlightStart, c.pShadow[ch], c.pHighlight[ch]);
+  }
+  int linearPixels = 0;
+
+  for (int i0 = 0; i0 < n; i0 += kSoATile) {
+    const int m = std::min(kSoATile, n - i0);
+    const float* s = src + 4 * (std::size_t)i0;
+    float* d = dst + 4 * (std::size_t)i0;
+
+    for (int i = 0; i < m; ++i) {
+      planes[0][i] = s[4 * i + 0];
+      planes[1][i] = s[4 * i + 1];
+      planes[2][i] = s[4 * i + 2];
+    }
+    for (int ch = 0; ch < 3; ++ch) curvePlane<V>(planes[ch], linear[ch], m, setup[ch]);
+    for (int i = 0; i < m; ++i) {
+      const float a = s[4 * i + 3]; // read before the store in case src == dst
+      d[4 * i + 0] = planes[0][i];
+      d[4 * i + 1] = planes[1][i];
+      d[4 * i + 2] = planes[2][i];
+      d[4 * i + 3] = a;
+      linearPixels += linear[0][i] & linear[1][i] & linear[2][i];
+    }
+  }
+  return linearPixels;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+static int processRowFast(const float* src, float* dst, int n, const CurveSetup& c) {
+#ifdef SPLITTONE_HAVE_SSE2
+  return processRowSoABody<LaneSse2>(src, dst, n, c);
+#else
+  return processRowSoABody<LaneScalar<false> >(src, dst, n, c);
+#endif
+}
+
+#ifdef SPLITTONE_X86_DISPATCH
+__attribute__((target("avx2,fma")))
+static int processRowFastAvx2(const float* src, float* dst, int n, const CurveSetup& c) {
+  return processRowSoABody<LaneAvx2<false> >(src, dst, n, c);
+}
+
+__attribute__((target("avx2,fma")))
+static int processRowFastAvx2Fma(const float* src, float* dst, int n, const CurveSetup& c) {
+  return processRowSoABody<LaneAvx2<true> >(src, dst, n, c);
+}
+
+__attribute__((target("avx512f,avx512vl,avx512bw,avx512dq")))
+static int processRowFastAvx512(const float* src, float* dst, int n, const CurveSetup& c) {
+  return processRowSoABody<LaneAvx512<false> >(src, dst, n, c);
+}
+
+__attribute__((target("avx512f,avx512vl,avx512bw,avx512dq")))
+static int processRowFastAvx512Fma(const float* src, float* dst, int n, const CurveSetup& c) {
+  return processRowSoABody<LaneAvx512<true> >(src, dst, n, c);
+}
+
+static bool cpuHasAvx2() {
+  static const bool has = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  return has && cpuLevelLimit().load(std::memory_order_relaxed) >= kCpuAvx2;
+}
+
+static bool cpuHasAvx512() {
+  static const bool has = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+                          __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") &&
+                          __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq");
+  return has && cpuLevelLimit().load(std::memory_order_relaxed) >= kCpuAvx512;
+}
+#endif
+
+// Widest fast kernel this CPU runs. Deterministic mode never uses the FMA clones.
+static RowKernelFn selectFastKernel(bool deterministic) {
+#ifdef SPLITTONE_X86_DISPATCH
+  if (cpuHasAvx512()) return deterministic ? processRowFastAvx512 : processRowFastAvx512Fma;
+  if (cpuHasAvx2()) return deterministic ? processRowFastAvx2 : processRowFastAvx2Fma;
+#else
+  (void)deterministic;
+#endif
+  return processRowFast;
+}
+
+static RowKernelFn selectRowKernel(const ParamsSnapshot& p) {
+  if (p.kernel == kKernelFast) return selectFastKernel(p.deterministic);
+  return p.deterministic ? processRowDeterministicSpecialized : processRowScalarSpecialized;
+}
+
+// Transparent blocks
+// Premultiplied CG elements are mostly transparent black, which grades to itself: the curve maps 0
+// to +0 and alpha passes through. Rows are scanned in blocks of kAlphaBlock pixels; the kernel runs
+// over each run of blocks holding anything else, and all-zero blocks (either sign) get +0 color
+// and their alpha copied. Transparent pixels with color (additive or emissive elements) are still
+// graded, so the output is exactly what the kernel gives.
+static const int kAlphaBlock = 64;
+
+// Ors the bit patterns four pixels at a time; only the sign bit may be set.
+static inline bool isTransparentBlack(const float* px, int n) {
+  const int count = n * 4;
+  for (int i = 0; i < count; i += 16) {
+    const int m = std::min(16, count - i);
+    uint32_t bits = 0;
+    for (int k = 0; k < m; ++k) {
+      uint32_t w;
+      std::memcpy(&w, px + i + k, sizeof(w));
+      bits |= w;
+    }
+    if (bits & 0x7fffffffu) return false;
+  }
+  return true;
+}
+
+// A row kernel call that skips transparent blocks; transparent counts the pixels skipped.
+static int gradeSparseRow(RowKernelFn kernel, const float* src, float* dst, int n, const CurveSetup& c,
+                          uint64_t& transparent) {
+  const int zeroLinear = c.shadowEnd <= 0.0f; // what isLinearZone says about 0
+  int linear = 0;
+  int run = 0; // first pixel of the pending run of non-transparent blocks
+  for (int i = 0; i < n; i += kAlphaBlock) {
+    const int m = std::min(kAlphaBlock, n - i);
+    const float* s = src + (std::size_t)i * 4;
+    if (!isTransparentBlack(s, m)) continue;
+    if (run < i) linear += kernel(src + (std::size_t)run * 4, dst + (std::size_t)run * 4, i - run, c);
+    float* d = dst + (std::size_t)i * 4;
+    for (int k = 0; k < m; ++k, s += 4, d += 4) {
+      const float a = s[3];
+      d[0] = 0.0f;
+      d[1] = 0.0f;
+      d[2] = 0.0f;
+      d[3] = a;
+    }
+    linear += zeroLinear * m;
+    transparent += (uint64_t)m;
+    run = i + m;
+  }
+  if (run < n) linear += kernel(src + (std::size_t)run * 4, dst + (std::size_t)run * 4, n - run, c);
+  return linear;
+}
+
+// Paused-frame LUT cache
+// While a colorist drags a slider on a paused frame, the source pixels and the zone boundaries stay
+// the same and only the exponents change. For such renders each pixel channel's zone and log2 of
+// its zone ratio are cached as a fixed-point position into per-channel tables of 2^(p * L), so a
+// slider change rebuilds six small tables and gathers. Interpolating the tables adds up to ~5e-6
+// relative error (p = 2), so the cache only serves interactive renders outside deterministic mode.
+// The gather is about 2.5x faster than the Reference kernel but not faster than the SIMD Fast
+// kernels, so Fast renders never use it.
+// Ratios below the table range (under 2^-64) are rare and evaluated exactly.
+static const int kLutLog2Range = 64;                  // tables cover L = log2(ratio) in [-64, 0]
+static const int kLutStepsPerOctave = 256;
+static const int kLutSize = kLutLog2Range * kLutStepsPerOctave + 1;
+static const uint32_t kLutZoneShift = 30;             // 0 passthrough, 1 shadow, 2 highlight, 3 exact
+static const uint32_t kLutPositionMask = (1u << kLutZoneShift) - 1; // table position, 16.16 fixed point
+
+// Tables for one render, rebuilt from the current exponents: shadowEnd * 2^(pShadow * L) and
+// highlightStart + range * 2^(pHighlight * L) at L = i / kLutStepsPerOctave - kLutLog2Range.
+// Indexed by zone and channel; the passthrough and exact zones point at a pair of zeros so the
+// gather can interpolate unconditionally.
+struct CurveLut {
+  const float* table[4][3];
+  CurveSetup curve; // for the rare ratios below the table range
+};
+
+static const std::size_t kCurveLutFloats = 6 * (std::size_t)kLutSize;
+
+static inline CurveLut makeCurveLut(float* storage, const CurveSetup& c) {
+  static const float kZeros[2] = {0.0f, 0.0f};
+  CurveLut lut;
+  lut.curve = c;
+  const float range = 1.0f - c.highlightStart;
+  for (int ch = 0; ch < 3; ++ch) {
+    float* shadow = storage + (std::size_t)(2 * ch) * kLutSize;
+    float* highlight = storage + (std::size_t)(2 * ch + 1) * kLutSize;
+    for (int i = 0; i < kLutSize; ++i) {
+      const float l = (float)i / (float)kLutStepsPerOctave - (float)kLutLog2Range;
+      shadow[i] = c.shadowEnd * std::exp2(c.pShadow[ch] * l);
+      highlight[i] = c.highlightStart + range * std::exp2(c.pHighlight[ch] * l);
+    }
+    lut.table[0][ch] = kZeros;
+    lut.table[1][ch] = shadow;
+    lut.table[2][ch] = highlight;
+    lut.table[3][ch] = kZeros;
+  }
+  return lut;
+}
+
+// Zone and table position of one channel value, following applyCurve's zones.
+static inline uint32_t lutCoordinate(float x, float shadowEnd, float highlightStart) {
+  x = std::max(0.0f, x);
+  float ratio;
+  uint32_t zone;
+  if (x <= shadowEnd) {
+    if (!(shadowEnd > 0.0f)) return 0;
+    ratio = x / shadowEnd;
+    zone = 1;
+  } else if (x <= highlightStart || x > 1.0f) {
+    return 0;
+  } else {
+    const float range = 1.0f - highlightStart;
+    if (!(range > 0.0f)) return 0;
+    ratio = (x - highlightStart) / range;
+    zone = 2;
+  }
+  ratio = clampf(ratio, 0.0f, 1.0f);
+  if (!(ratio > 0.0f)) return 0; // pow(0, p) is 0, which is x itself here
+  const double position = ((double)std::log2(ratio) + kLutLog2Range) * kLutStepsPerOctave * 65536.0;
+  if (position < 0.0) return 3u << kLutZoneShift; // near zero the clamped table would be far off
+  const uint32_t fixed = (uint32_t)std::min((double)kLutPositionMask, position + 0.5);
+  return zone << kLutZoneShift | fixed;
+}
+
+static inline void lutCoordinatesRow(const float* src, uint32_t* coords, int n, const CurveSetup& c) {
+  for (int i = 0; i < n; ++i) {
+    for (int ch = 0; ch < 3; ++ch) coords[3 * i + ch] = lutCoordinate(src[4 * i + ch], c.shadowEnd, c.highlightStart);
+  }
+}
+
+// Row kernel over cached coordinates (3 per pixel); returns the pixels that stayed linear.
+static int gatherRow(const float* src, float* dst, const uint32_t* coords, int n, const CurveLut& lut) {
+  int linear = 0;
+  for (int i = 0; i < n; ++i, src += 4, dst += 4, coords += 3) {
+    uint32_t zones = 0;
+    const float a = src[3];
+    for (int ch = 0; ch < 3; ++ch) {
+      const uint32_t code = coords[ch];
+      const uint32_t zone = code >> kLutZoneShift;
+      const float* t = lut.table[zone][ch];
+      const uint32_t idx = (code & kLutPositionMask) >> 16;
+      const float frac = (float)(code & 0xffffu) * (1.0f / 65536.0f);
+      const float curved = t[idx] + frac * (t[idx + 1] - t[idx]);
+      const float x = std::max(0.0f, src[ch]);
+      dst[ch] = zone ? curved : x;
+      if (zone == 3) {
+        const CurveSetup& c = lut.curve;
+        dst[ch] = applyCurve(x, c.shadowEnd, c.highlightStart, c.pShadow[ch], c.pHighlight[ch]);
+      }
+      zones |= zone;
+    }
+    dst[3] = a;
+    linear += zones == 0;
+  }
+  return linear;
+}
+
+// Identifies a frame whose coordinates can be reused: same time, window and zone boundaries, and
+// (checked separately) the same source pixels.
+struct LutFrameKey {
+  double time = 0.0;
+  OfxRectI window = {0, 0, 0, 0};
+  int preset = 0;
+  float preserveMidgray = 0.0f;
+
+  bool operator==(const LutFrameKey& o) const {
+    return time == o.time && window.x1 == o.window.x1 && window.y1 == o.window.y1 && window.x2 == o.window.x2 &&
+           window.y2 == o.window.y2 && preset == o.preset && preserveMidgray == o.preserveMidgray;
+  }
+};
+
+struct LutFrame {
+  const void* owner = nullptr; // the LutFrameCache that built it
+  LutFrameKey key;
+  uint64_t sourceHash = 0;
+  std::vector<uint32_t> coords; // 3 per render-window pixel, row-major; empty until built
+};
+
+static const uint64_t kHashSeed = 1469598103934665603ull;
+
+// Word-wise multiply-xor hash of bytes, continuing from h; a short tail is zero-padded to a word.
+// Runs of 32 bytes go through four independently seeded lanes so the multiplies overlap.
+static inline uint64_t hashBytes(uint64_t h, const void* data, std::size_t bytes) {
+  const unsigned char* p = (const unsigned char*)data;
+  std::size_t i = 0;
+  if (bytes >= 32) {
+    uint64_t lane[4] = {h, h ^ 0x9e3779b97f4a7c15ull, h ^ 0xc2b2ae3d27d4eb4full, h ^ 0x165667b19e3779f9ull};
+    for (; i + 32 <= bytes; i += 32) {
+      for (int k = 0; k < 4; ++k) {
+        uint64_t w;
+        std::memcpy(&w, p + i + 8 * k, sizeof(w));
+        lane[k] = (lane[k] ^ w) * 1099511628211ull;
+        lane[k] ^= lane[k] >> 29;
+      }
+    }
+    h = lane[0];
+    for (int k = 1; k < 4; ++k) {
+      h = (h ^ lane[k]) * 1099511628211ull;
+      h ^= h >> 29;
+    }
+  }
+  for (; i + 8 <= bytes; i += 8) {
+    uint64_t w;
+    std::memcpy(&w, p + i, sizeof(w));
+    h = (h ^ w) * 1099511628211ull;
+    h ^= h >> 29;
+  }
+  if (i < bytes) {
+    uint64_t w = 0;
+    std::memcpy(&w, p + i, bytes - i);
+    h = (h ^ w) * 1099511628211ull;
+    h ^= h >> 29;
+  }
+  return h;
+}
+
+// Hash of the source pixels in a window, to notice upstream changes on a frame that is otherwise
+// the same.
+static uint64_t hashSourceWindow(const ImageView& src, const OfxRectI& window) {
+  uint64_t h = kHashSeed;
+  const OfxRectI b = src.bounds;
+  const int bounds[4] = {b.x1, b.y1, b.x2, b.y2}; // a different tile leaves other pixels uncovered
+  for (int v : bounds) h = (h ^ (uint64_t)(uint32_t)v) * 1099511628211ull;
+  const int x1 = std::max(window.x1, b.x1), x2 = std::min(window.x2, b.x2);
+  if (x1 >= x2) return h;
+  const std::size_t bytes = (std::size_t)(x2 - x1) * (std::size_t)src.pixelBytes;
+  for (int y = std::max(window.y1, b.y1); y < std::min(window.y2, b.y2); ++y) {
+    const unsigned char* p = (const unsigned char*)src.getPixelAddress(x1, y);
+    if (p) h = hashBytes(h, p, bytes);
+  }
+  return h;
+}
+
+// Built LUT frames of all instances, under one byte budget: the least recently used frame goes
+// first, whichever instance it belongs to. Entries are immutable once published and shared with
+// running renders.
+class LutFrameStore {
+public:
+  static const std::size_t kMaxBytes = std::size_t(128) << 20; // one UHD frame of coordinates
+  static const std::size_t kMaxFrames = 64;
+
+  static LutFrameStore& instance() {
+    static LutFrameStore store;
+    return store;
+  }
+
+  std::shared_ptr<const LutFrame> find(const void* owner, const LutFrameKey& key) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto it = _frames.begin(); it != _frames.end(); ++it) {
+      if ((*it)->owner == owner && (*it)->key == key) {
+        std::rotate(it, it + 1, _frames.end()); // most recently used last
+        return _frames.back();
+      }
+    }
+    return nullptr;
+  }
+
+  void publish(const std::shared_ptr<const LutFrame>& frame) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto it = _frames.begin(); it != _frames.end(); ++it) {
+      if ((*it)->owner == frame->owner && (*it)->key == frame->key) {
+        _bytes -= frameBytes(**it);
+        _frames.erase(it);
+        break;
+      }
+    }
+    _frames.push_back(frame);
+    _bytes += frameBytes(*frame);
+    // Renders only build frames that fit the budget on their own.
+    while (_bytes > kMaxBytes || _frames.size() > kMaxFrames) {
+      _bytes -= frameBytes(*_frames.front());
+      _frames.erase(_frames.begin());
+    }
+  }
+
+  // Drops an instance's frames when it is destroyed.
+  void forget(const void* owner) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto it = _frames.begin(); it != _frames.end();) {
+      if ((*it)->owner == owner) {
+        _bytes -= frameBytes(**it);
+        it = _frames.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  void usage(std::size_t& frames, std::size_t& bytes) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    frames = _frames.size();
+    bytes = _bytes;
+  }
+
+private:
+  static std::size_t frameBytes(const LutFrame& f) { return f.coords.size() * sizeof(uint32_t); }
+
+  std::mutex _mutex;
+  std::vector<std::shared_ptr<const LutFrame>> _frames;
+  std::size_t _bytes = 0;
+};
+
+// One instance's view of the LUT frames. A frame seen for the first time only has its key
+// remembered, in a fixed ring, so playback, where every frame is new, neither builds coordinates
+// nor allocates; a frame rendered again gets coordinates built, and is kept in LutFrameStore.
+class LutFrameCache {
+public:
+  LutFrameCache() = default;
+  LutFrameCache(const LutFrameCache&) = delete;
+  LutFrameCache& operator=(const LutFrameCache&) = delete;
+  ~LutFrameCache() { LutFrameStore::instance().forget(this); }
+
+  // The frame for key; one without coordinates when it was only seen before, null the first time.
+  std::shared_ptr<const LutFrame> lookup(const LutFrameKey& key) {
+    static const std::shared_ptr<const LutFrame> seenOnly = std::make_shared<LutFrame>();
+    if (std::shared_ptr<const LutFrame> frame = LutFrameStore::instance().find(this, key)) return frame;
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (int i = 0; i < _seenCount; ++i) {
+      if (_seen[i] == key) return seenOnly;
+    }
+    _seen[_seenNext] = key;
+    _seenNext = (_seenNext + 1) % kSeenKeys;
+    _seenCount = std::min(_seenCount + 1, kSeenKeys);
+    return nullptr;
+  }
+
+  // frame->owner is set here.
+  void publish(const std::shared_ptr<LutFrame>& frame) {
+    frame->owner = this;
+    LutFrameStore::instance().publish(frame);
+  }
+
+private:
+  static const int kSeenKeys = 64;
+
+  std::mutex _mutex;
+  LutFrameKey _seen[kSeenKeys];
+  int _seenNext = 0;
+  int _seenCount = 0;
+};
+
+// Static tile reuse
+// On locked-off shots most of the frame repeats from one frame to the next. With Reuse Static
+// Tiles on, an instance keeps the source and graded output of its previous frame for each render
+// window, split into kStaticTile squares; a tile whose source compares equal to last time's, byte
+// for byte, is copied from there instead of graded. The stored output was produced by the same
+// grade on the same pixels, so reused tiles are bit-identical to grading them again.
+static const int kStaticTile = 64;
+
+// Where a stored frame sits: one frame is kept per render window of an instance.
+struct StaticTileKey {
+  const void* owner = nullptr; // the renderer
+  OfxRectI window = {0, 0, 0, 0};
+  OfxRectI srcBounds = {0, 0, 0, 0};
+  OfxRectI dstBounds = {0, 0, 0, 0}; // the burned-in curve is laid out over the output bounds
+  OFX::BitDepthEnum srcDepth = OFX::eBitDepthNone;
+  OFX::BitDepthEnum dstDepth = OFX::eBitDepthNone;
+
+  bool operator==(const StaticTileKey& o) const {
+    return owner == o.owner && sameRect(window, o.window) && sameRect(srcBounds, o.srcBounds) &&
+           sameRect(dstBounds, o.dstBounds) && srcDepth == o.srcDepth && dstDepth == o.dstDepth;
+  }
+
+  static bool sameRect(const OfxRectI& a, const OfxRectI& b) {
+    return a.x1 == b.x1 && a.y1 == b.y1 && a.x2 == b.x2 && a.y2 == b.y2;
+  }
+};
+
+// Everything besides the source pixels that the stored output depends on.
+struct StaticTileGrade {
+  ParamsSnapshot params;
+  int ditherMode = 0;
+  int ditherBits = 0;
+
+  bool operator==(const StaticTileGrade& o) const {
+    const ParamsSnapshot& a = params;
+    const ParamsSnapshot& b = o.params;
+    if (ditherMode != o.ditherMode || ditherBits != o.ditherBits || a.preset != b.preset ||
+        a.preserveMidgray != b.preserveMidgray || a.burnInCurve != b.burnInCurve ||
+        a.deterministic != b.deterministic || a.kernel != b.kernel) {
+      return false;
+    }
+    for (int i = 0; i < 3; ++i) {
+      if (a.pShadow[i] != b.pShadow[i] || a.pHighlight[i] != b.pHighlight[i]) return false;
+    }
+    return true;
+  }
+};
+
+// The previous frame rendered for a key, and the grade it was rendered with. Tiles cover the part
+// of the window inside both images, row by row; source holds their input at the source depth and
+// pixels their output at the destination depth, both row-major over that area. A tile is only
+// compared or copied while valid is set for it.
+struct StaticTileFrame {
+  StaticTileKey key;
+  StaticTileGrade grade;
+  std::vector<unsigned char> valid;
+  std::vector<unsigned char> source;
+  std::vector<unsigned char> pixels;
+
+  std::size_t bytes() const { return source.size() + pixels.size(); }
+};
+
+// Frames of all instances, under one byte budget: the least recently rendered frame goes first,
+// whichever instance it belongs to. A render checks its window's frame out, updates it in place
+// while copying and grading tiles, and checks it back in unless aborted; a concurrent render of
+// the same window meanwhile starts a fresh frame, and whichever is checked in last is kept.
+class StaticTileStore {
+public:
+  static const std::size_t kMaxBytes = std::size_t(256) << 20; // two UHD float frames
+  static const std::size_t kMaxFrames = 64;
+
+  static StaticTileStore& instance() {
+    static StaticTileStore store;
+    return store;
+  }
+
+  // A frame for key, with the previous frame's tiles when it was rendered with the same grade. A
+  // new grade keeps the buffers but forgets every tile, so a slider drag regrades without allocating.
+  std::unique_ptr<StaticTileFrame> checkOut(const StaticTileKey& key, const StaticTileGrade& grade) {
+    std::unique_ptr<StaticTileFrame> f;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      for (auto it = _frames.begin(); it != _frames.end(); ++it) {
+        if ((*it)->key == key) {
+          f = std::move(*it);
+          _frames.erase(it);
+          _bytes -= f->bytes();
+          break;
+        }
+      }
+    }
+    if (!f) {
+      f.reset(new StaticTileFrame);
+      f->key = key;
+    }
+    if (!(f->grade == grade)) {
+      f->grade = grade;
+      std::fill(f->valid.begin(), f->valid.end(), 0);
+    }
+    return f;
+  }
+
+  void checkIn(std::unique_ptr<StaticTileFrame> frame) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto it = _frames.begin(); it != _frames.end(); ++it) {
+      if ((*it)->key == frame->key) {
+        _bytes -= (*it)->bytes();
+        _frames.erase(it);
+        break;
+      }
+    }
+    _bytes += frame->bytes();
+    _frames.push_back(std::move(frame)); // most recently rendered last
+    // Renders only use frames that fit the budget on their own.
+    while (_bytes > kMaxBytes || _frames.size() > kMaxFrames) {
+      _bytes -= _frames.front()->bytes();
+      _frames.erase(_frames.begin());
+    }
+  }
+
+  // Drops an instance's frames when it is destroyed.
+  void forget(const void* owner) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto it = _frames.begin(); it != _frames.end();) {
+      if ((*it)->key.owner == owner) {
+        _bytes -= (*it)->bytes();
+        it = _frames.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  void usage(std::size_t& frames, std::size_t& bytes) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    frames = _frames.size();
+    bytes = _bytes;
+  }
+
+private:
+  std::mutex _mutex;
+  std::vector<std::unique_ptr<StaticTileFrame>> _frames;
+  std::size_t _bytes = 0;
+};
+
+// Render statistics
+// Every thread that touches the plugin gets its own cache-line aligned slot, so counting never
+// shares a line between threads. Totals are only summed when a report is requested.
+static const int kStatsSlots = 64;
+static const int kLatencyBuckets = 24; // bucket i holds renders taking [2^(i-1), 2^i) microseconds
+static const std::size_t kCacheLine = 64;
+
+// Host suite calls the plugin makes, per OFX action. Dispatch is the time process() spends
+// outside the workers: handing the window to the threading backend and joining it.
+enum HostAction { kActionRender, kActionIsIdentity, kActionCount };
+enum HostCall { kHostFetchImage, kHostGetParams, kHostDispatch, kHostCallCount };
+
+static const char* const kActionNames[kActionCount] = { "render", "isIdentity" };
+static const char* const kHostCallNames[kHostCallCount] = {
+  "fetchImage", "getParamsAtTime", "multiThread"
+};
+
+struct alignas(kCacheLine) StatsSlot {
+  std::atomic<uint64_t> pixels{0};
+  std::atomic<uint64_t> fastPathPixels{0};
+  std::atomic<uint64_t> transparentPixels{0};
+  std::atomic<uint64_t> renders{0};
+  std::atomic<uint64_t> identities{0};
+  std::atomic<uint64_t> renderNanos{0};
+  std::atomic<uint64_t> kernelNanos{0};
+  std::atomic<uint64_t> kernelBytes{0};
+  std::atomic<uint64_t> scratchAllocs{0};
+  std::atomic<uint64_t> workerThreads{0};
+  std::atomic<uint64_t> inlineRenders{0};
+  std::atomic<uint64_t> lutRenders{0};
+  std::atomic<uint64_t> lutBuilds{0};
+  std::atomic<uint64_t> staticTiles{0};
+  std::atomic<uint64_t> reusedTiles{0};
+  std::atomic<uint64_t> latency[kLatencyBuckets];
+
+  // Hardware counters, only accumulated while "Hardware Counters" is enabled.
+  std::atomic<uint64_t> counterPixels{0};
+  std::atomic<uint64_t> cycles{0};
+  std::atomic<uint64_t> instructions{0};
+  std::atomic<uint64_t> llcMisses{0};
+  std::atomic<uint64_t> branchMisses{0};
+
+  std::atomic<uint64_t> hostCalls[kActionCount][kHostCallCount];
+  std::atomic<uint64_t> hostNanos[kActionCount][kHostCallCount];
+
+  StatsSlot() {
+    for (int i = 0; i < kLatencyBuckets; ++i) latency[i].store(0, std::memory_order_relaxed);
+    for (int a = 0; a < kActionCount; ++a) {
+      for (int c = 0; c < kHostCallCount; ++c) {
+        hostCalls[a][c].store(0, std::memory_order_relaxed);
+        hostNanos[a][c].store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+};
+
+struct StatsTotals {
+  uint64_t pixels = 0;
+  uint64_t fastPathPixels = 0;
+  uint64_t transparentPixels = 0;
+  uint64_t renders = 0;
+  uint64_t identities = 0;
+  uint64_t renderNanos = 0;
+  uint64_t kernelNanos = 0;
+  uint64_t kernelBytes = 0;
+  uint64_t scratchAllocs = 0;
+  uint64_t workerThreads = 0;
+  uint64_t inlineRenders = 0;
+  uint64_t lutRenders = 0;
+  uint64_t lutBuilds = 0;
+  uint64_t staticTiles = 0;
+  uint64_t reusedTiles = 0;
+  uint64_t latency[kLatencyBuckets] = {};
+
+  uint64_t counterPixels = 0;
+  uint64_t cycles = 0;
+  uint64_t instructions = 0;
+  uint64_t llcMisses = 0;
+  uint64_t branchMisses = 0;
+
+  uint64_t hostCalls[kActionCount][kHostCallCount] = {};
+  uint64_t hostNanos[kActionCount][kHostCallCount] = {};
+};
+
+struct HwSample {
+  uint64_t cycles = 0;
+  uint64_t instructions = 0;
+  uint64_t llcMisses = 0;
+  uint64_t branchMisses = 0;
+};
+
+static inline int statsSlotIndex() {
+  static std::atomic<int> nextSlot{0};
+  thread_local int slot = nextSlot.fetch_add(1, std::memory_order_relaxed) % kStatsSlots;
+  return slot;
+}
+
+static inline uint64_t steadyNanos() {
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static inline int latencyBucket(uint64_t nanos) {
+  uint64_t us = nanos / 1000;
+  int b = 0;
+  while (us && b < kLatencyBuckets - 1) { us >>= 1; ++b; }
+  return b;
+}
+
+class RenderStats {
+public:
+  RenderStats() {
+    // operator new only guarantees 16-byte alignment before C++17, so align the slots by hand.
+    _storage.reset(new unsigned char[sizeof(StatsSlot) * kStatsSlots + kCacheLine]);
+    const std::uintptr_t base = reinterpret_cast<std::uintptr_t>(_storage.get());
+    _slots = reinterpret_cast<StatsSlot*>((base + kCacheLine - 1) & ~(std::uintptr_t)(kCacheLine - 1));
+    for (int i = 0; i < kStatsSlots; ++i) new (&_slots[i]) StatsSlot();
+  }
+
+  RenderStats(const RenderStats&) = delete;
+  RenderStats& operator=(const RenderStats&) = delete;
+
+  StatsSlot& local() { return _slots[statsSlotIndex()]; }
+
+  // transparent: pixels of transparent blocks written without the kernel (part of pixels).
+  void addPixels(uint64_t pixels, uint64_t fastPathPixels, uint64_t transparent = 0) {
+    StatsSlot& s = local();
+    s.pixels.fetch_add(pixels, std::memory_order_relaxed);
+    s.fastPathPixels.fetch_add(fastPathPixels, std::memory_order_relaxed);
+    if (transparent) s.transparentPixels.fetch_add(transparent, std::memory_order_relaxed);
+  }
+
+  // kernelBytes: source plus destination bytes of the render window, at their actual depths.
+  void addRender(uint64_t nanos, uint64_t kernelNanos, uint64_t kernelBytes) {
+    StatsSlot& s = local();
+    s.renders.fetch_add(1, std::memory_order_relaxed);
+    s.renderNanos.fetch_add(nanos, std::memory_order_relaxed);
+    s.kernelNanos.fetch_add(kernelNanos, std::memory_order_relaxed);
+    s.kernelBytes.fetch_add(kernelBytes, std::memory_order_relaxed);
+    s.latency[latencyBucket(nanos)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void addCounters(uint64_t pixels, const HwSample& hw) {
+    StatsSlot& s = local();
+    s.counterPixels.fetch_add(pixels, std::memory_order_relaxed);
+    s.cycles.fetch_add(hw.cycles, std::memory_order_relaxed);
+    s.instructions.fetch_add(hw.instructions, std::memory_order_relaxed);
+    s.llcMisses.fetch_add(hw.llcMisses, std::memory_order_relaxed);
+    s.branchMisses.fetch_add(hw.branchMisses, std::memory_order_relaxed);
+  }
+
+  void addIdentity() { local().identities.fetch_add(1, std::memory_order_relaxed); }
+
+  void addHostCalls(HostAction action, HostCall call, uint64_t calls, uint64_t nanos) {
+    StatsSlot& s = local();
+    s.hostCalls[action][call].fetch_add(calls, std::memory_order_relaxed);
+    s.hostNanos[action][call].fetch_add(nanos, std::memory_order_relaxed);
+  }
+
+  void addScratchAllocations(uint64_t n) { local().scratchAllocs.fetch_add(n, std::memory_order_relaxed); }
+
+  void addFanOut(unsigned int threads) {
+    StatsSlot& s = local();
+    s.workerThreads.fetch_add(threads, std::memory_order_relaxed);
+    if (threads <= 1) s.inlineRenders.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // A render served from the paused-frame LUT cache; built when it had to compute the coordinates.
+  void addLutRender(bool built) {
+    StatsSlot& s = local();
+    s.lutRenders.fetch_add(1, std::memory_order_relaxed);
+    if (built) s.lutBuilds.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Tiles of a render with Reuse Static Tiles on, and how many were copied from the last frame.
+  void addStaticTiles(uint64_t tiles, uint64_t reused) {
+    StatsSlot& s = local();
+    s.staticTiles.fetch_add(tiles, std::memory_order_relaxed);
+    s.reusedTiles.fetch_add(reused, std::memory_order_relaxed);
+  }
+
+  StatsTotals totals() const {
+    StatsTotals t;
+    for (int i = 0; i < kStatsSlots; ++i) {
+      const StatsSlot& s = _slots[i];
+      t.pixels += s.pixels.load(std::memory_order_relaxed);
+      t.fastPathPixels += s.fastPathPixels.load(std::memory_order_relaxed);
+      t.transparentPixels += s.transparentPixels.load(std::memory_order_relaxed);
+      t.renders += s.renders.load(std::memory_order_relaxed);
+      t.identities += s.identities.load(std::memory_order_relaxed);
+      t.renderNanos += s.renderNanos.load(std::memory_order_relaxed);
+      t.kernelNanos += s.kernelNanos.load(std::memory_order_relaxed);
+      t.kernelBytes += s.kernelBytes.load(std::memory_order_relaxed);
+      t.scratchAllocs += s.scratchAllocs.load(std::memory_order_relaxed);
+      t.workerThreads += s.workerThreads.load(std::memory_order_relaxed);
+      t.inlineRenders += s.inlineRenders.load(std::memory_order_relaxed);
+      t.lutRenders += s.lutRenders.load(std::memory_order_relaxed);
+      t.lutBuilds += s.lutBuilds.load(std::memory_order_relaxed);
+      t.staticTiles += s.staticTiles.load(std::memory_order_relaxed);
+      t.reusedTiles += s.reusedTiles.load(std::memory_order_relaxed);
+      t.counterPixels += s.counterPixels.load(std::memory_order_relaxed);
+      t.cycles += s.cycles.load(std::memory_order_relaxed);
+      t.instructions += s.instructions.load(std::memory_order_relaxed);
+      t.llcMisses += s.llcMisses.load(std::memory_order_relaxed);
+      t.branchMisses += s.branchMisses.load(std::memory_order_relaxed);
+      for (int b = 0; b < kLatencyBuckets; ++b) t.latency[b] += s.latency[b].load(std::memory_order_relaxed);
+      for (int a = 0; a < kActionCount; ++a) {
+        for (int c = 0; c < kHostCallCount; ++c) {
+          t.hostCalls[a][c] += s.hostCalls[a][c].load(std::memory_order_relaxed);
+          t.hostNanos[a][c] += s.hostNanos[a][c].load(std::memory_order_relaxed);
+        }
+      }
+    }
+    return t;
+  }
+
+private:
+  std::unique_ptr<unsigned char[]> _storage;
+  StatsSlot* _slots = nullptr;
+};
+
+// Per-thread scratch arenas
+// Any scratch a render needs is bump-allocated from the arena of the thread that uses it, so
+// concurrent renders of many instances never meet in the heap allocator. Arenas live as long as
+// their thread and keep their high-water capacity, so once warmed up a render allocates nothing.
+// That capacity is a per-thread peak: a worker stages kStageRows float rows of its window (480 KB
+// at UHD width), and the thread that starts a render also holds the paused-frame LUT tables
+// (kCurveLutFloats, 384 KB) on top of whatever it grades itself.
+class ScratchArena {
+public:
+  static ScratchArena& forThisThread() {
+    thread_local ScratchArena arena;
+    return arena;
+  }
+
+  void* alloc(std::size_t bytes, std::size_t align = kCacheLine) {
+    for (;;) {
+      if (_block < _blocks.size()) {
+        Block& b = _blocks[_block];
+        const std::uintptr_t base = reinterpret_cast<std::uintptr_t>(b.data.get());
+        const std::uintptr_t p = (base + _offset + align - 1) & ~(std::uintptr_t)(align - 1);
+        if (p + bytes <= base + b.size) {
+          _offset = (std::size_t)(p - base) + bytes;
+          return reinterpret_cast<void*>(p);
+        }
+        if (_block + 1 < _blocks.size()) { ++_block; _offset = 0; continue; }
+      }
+      grow(bytes + align);
+    }
+  }
+
+  template <class T>
+  T* allocArray(std::size_t n) { return static_cast<T*>(alloc(n * sizeof(T), std::max(alignof(T), kCacheLine))); }
+
+  // Blocks all arenas have taken from the heap so far, which stops growing once they are warm.
+  // This is only the arenas; the allocations test checks that a warm render allocates nothing at all.
+  static uint64_t blocksAllocated() { return heapAllocs().load(std::memory_order_relaxed); }
+
+private:
+  friend class ScratchScope;
+
+  struct Block {
+    std::unique_ptr<unsigned char[]> data;
+    std::size_t size;
+  };
+
+  static const std::size_t kMinBlock = 256 * 1024;
+
+  static std::atomic<uint64_t>& heapAllocs() {
+    static std::atomic<uint64_t> n{0};
+    return n;
+  }
+
+  ScratchArena() { _blocks.reserve(8); }
+
+  void grow(std::size_t atLeast) {
+    const std::size_t size = std::max(atLeast, std::max((std::size_t)kMinBlock, _blocks.empty() ? 0 : 2 * _blocks.back().size));
+    _blocks.push_back(Block{std::unique_ptr<unsigned char[]>(new unsigned char[size]), size});
+    heapAllocs().fetch_add(1, std::memory_order_relaxed);
+    _block = _blocks.size() - 1;
+    _offset = 0;
+  }
+
+  // Called when the outermost scope closes: fold several blocks into one of their total size, so
+  // the next render with the same footprint is served from a single block without growing.
+  void consolidate() {
+    if (_blocks.size() <= 1) return;
+    std::size_t total = 0;
+    for (const Block& b : _blocks) total += b.size;
+    _blocks.clear();
+    _blocks.push_back(Block{std::unique_ptr<unsigned char[]>(new unsigned char[total]), total});
+    heapAllocs().fetch_add(1, std::memory_order_relaxed);
+  }
+
+  std::vector<Block> _blocks;
+  std::size_t _block = 0;
+  std::size_t _offset = 0;
+  int _depth = 0;
+};
+
+// Releases everything allocated from the arena since the scope was opened.
+class ScratchScope {
+public:
+  explicit ScratchScope(ScratchArena& arena)
+  : _arena(arena), _block(arena._block), _offset(arena._offset) { ++_arena._depth; }
+
+  ~ScratchScope() {
+    _arena._block = _block;
+    _arena._offset = _offset;
+    if (--_arena._depth == 0) {
+      _arena.consolidate();
+      _arena._block = 0;
+      _arena._offset = 0;
+    }
+  }
+
+  ScratchScope(const ScratchScope&) = delete;
+  ScratchScope& operator=(const ScratchScope&) = delete;
+
+private:
+  ScratchArena& _arena;
+  std::size_t _block;
+  std::size_t _offset;
+};
+
+// Threading backends
+// The processor's parallel-for, independent of who provides the threads: the host's multithread
+// suite, a built-in work-stealing pool, or OpenMP / TBB when the plugin is built with them. The
+// grade is per row, so every backend and chunking produces identical output.
+enum ThreadingBackend {
+  kThreadingHost = 0,
+  kThreadingPool = 1,
+  kThreadingOpenMP = 2,
+  kThreadingTbb = 3,
+  kThreadingBackendCount
+};
+
+static const char* const kThreadingNames[kThreadingBackendCount] = {"host suite", "built-in pool", "OpenMP", "TBB"};
+
+#ifndef SPLITTONE_DEFAULT_THREADING
+#define SPLITTONE_DEFAULT_THREADING 0 // kThreadingHost
+#endif
+
+static inline bool threadingAvailable(int backend) {
+  switch (backend) {
+  case kThreadingHost:
+  case kThreadingPool: return true;
+#ifdef _OPENMP
+  case kThreadingOpenMP: return true;
+#endif
+#ifdef SPLITTONE_WITH_TBB
+  case kThreadingTbb: return true;
+#endif
+  default: return false;
+  }
+}
+
+// Non-owning reference to the per-chunk callable of a parallel-for, which outlives the call. Unlike
+// std::function it never allocates, whatever the lambda captures.
+class ChunkFn {
+public:
+  template <class F>
+  ChunkFn(const F& f)
+  : _obj(&f), _call([](const void* obj, int chunk) { (*static_cast<const F*>(obj))(chunk); }) {}
+
+  void operator()(int chunk) const { _call(_obj, chunk); }
+
+private:
+  const void* _obj;
+  void (*_call)(const void* obj, int chunk);
+};
+
+// First exception thrown by a chunk on any thread. Once set the remaining chunks are skipped, and
+// the caller rethrows it after every thread has left the job: an exception must neither escape a
+// worker (std::terminate, or the host's C boundary) nor unwind the caller while workers still run.
+struct ChunkError {
+  std::atomic<bool> failed{false};
+  std::exception_ptr error;
+
+  void capture() {
+    if (!failed.exchange(true, std::memory_order_acq_rel)) error = std::current_exception();
+  }
+  bool stopped() const { return failed.load(std::memory_order_relaxed); }
+  void rethrow() const {
+    if (error) std::rethrow_exception(error);
+  }
+};
+
+// Process-wide pool of hardware_concurrency - 1 threads; the caller of run() works as well. Each
+// participant starts on its own contiguous range of chunks and, once that is drained, steals
+// chunks from the others' ranges, so uneven rows (overlay bands, shadows-heavy areas) even out.
+// Several renders can run jobs at the same time; idle threads join whichever still has room.
+// The pool is never destroyed: joining threads from a static destructor deadlocks under the Windows
+// loader lock, so the plugin's unload action calls shutdown() instead.
+class WorkStealingPool {
+public:
+  static WorkStealingPool& instance() {
+    static WorkStealingPool* pool = new WorkStealingPool;
+    return *pool;
+  }
+
+  // Rethrows the first exception fn threw, once no thread is inside the job any more.
+  void run(int nChunks, unsigned int maxThreads, const ChunkFn& fn) {
+    if (nChunks <= 0) return;
+    Job job;
+    job.fn = &fn;
+    job.slots = (int)std::min(std::max(1u, maxThreads), (unsigned int)kMaxSlots);
+    job.slots = std::min(job.slots, nChunks);
+    for (int s = 0; s < job.slots; ++s) {
+      job.range[s].next.store((int)((int64_t)nChunks * s / job.slots), std::memory_order_relaxed);
+      job.range[s].end = (int)((int64_t)nChunks * (s + 1) / job.slots);
+    }
+    job.joined = 1; // slot 0 is the caller's
+
+    {
+      Registration registration(*this, job);
+      work(job, 0);
+    }
+    job.error.rethrow();
+  }
+
+  // Joins the threads; called from the unload action, when no render can be running. A later
+  // run() starts them again.
+  void shutdown() {
+    std::vector<std::thread> threads;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+      threads.swap(_threads);
+    }
+    _wake.notify_all();
+    for (auto& t : threads) t.join();
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = false;
+  }
+
+private:
+  static const unsigned int kMaxSlots = 256;
+
+  struct alignas(kCacheLine) Range {
+    std::atomic<int> next{0};
+    int end = 0;
+  };
+
+  struct Job {
+    const ChunkFn* fn = nullptr;
+    int slots = 0;
+    int joined = 0;  // slots handed out, under _mutex
+    int working = 0; // pool threads inside work(), under _mutex
+    ChunkError error;
+    Range range[kMaxSlots];
+  };
+
+  // Queues a job for the pool threads for as long as it is in scope. Leaving the scope, however
+  // that happens, takes the job off the queue and waits for the threads still inside it, so no
+  // thread ever sees a job whose stack frame is gone.
+  class Registration {
+  public:
+    Registration(WorkStealingPool& pool, Job& job) : _pool(pool), _job(job) {
+      if (job.slots <= 1) return;
+      {
+        std::lock_guard<std::mutex> lock(pool._mutex);
+        pool.startThreads();
+        pool._jobs.push_back(&job);
+      }
+      pool._wake.notify_all();
+    }
+
+    ~Registration() {
+      std::unique_lock<std::mutex> lock(_pool._mutex);
+      _pool._jobs.erase(std::remove(_pool._jobs.begin(), _pool._jobs.end(), &_job), _pool._jobs.end());
+      _pool._idle.wait(lock, [&] { return _job.working == 0; });
+    }
+
+    Registration(const Registration&) = delete;
+    Registration& operator=(const Registration&) = delete;
+
+  private:
+    WorkStealingPool& _pool;
+    Job& _job;
+  };
+
+  WorkStealingPool() = default;
+
+  void startThreads() {
+    if (!_threads.empty()) return;
+    const unsigned int n = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    for (unsigned int i = 0; i < n; ++i) _threads.emplace_back([this] { threadMain(); });
+  }
+
+  static void work(Job& job, int slot) {
+    auto take = [&](int s) {
+      if (job.error.stopped()) return -1;
+      const int c = job.range[s].next.fetch_add(1, std::memory_order_relaxed);
+      return c < job.range[s].end ? c : -1;
+    };
+    try {
+      for (int k = 0; k < job.slots; ++k) {
+        const int s = (slot + k) % job.slots; // own range first, then steal
+        for (int c = take(s); c >= 0; c = take(s)) (*job.fn)(c);
+      }
+    } catch (...) {
+      job.error.capture();
+    }
+  }
+
+  void threadMain() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (;;) {
+      Job* job = nullptr;
+      _wake.wait(lock, [&] {
+        if (_stop) return true;
+        for (Job* j : _jobs) {
+          if (j->joined < j->slots) {
+            job = j;
+            return true;
+          }
+        }
+        return false;
+      });
+      if (_stop) return;
+      const int slot = job->joined++;
+      ++job->working;
+      lock.unlock();
+      work(*job, slot);
+      lock.lock();
+      if (--job->working == 0) _idle.notify_all();
+    }
+  }
+
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  std::condition_variable _idle;
+  std::vector<Job*> _jobs;
+  std::vector<std::thread> _threads;
+  bool _stop = false;
+};
+
+// The host suite as a generic parallel-for: each host thread pulls chunks off a shared counter.
+class HostParallelFor : public OFX::MultiThread::Processor {
+public:
+  HostParallelFor(int nChunks, const ChunkFn& fn) : _nChunks(nChunks), _fn(fn) {}
+
+  void multiThreadFunction(unsigned int /*threadIndex*/, unsigned int /*threadMax*/) override {
+    try {
+      for (int c = _next.fetch_add(1, std::memory_order_relaxed); c < _nChunks && !error.stopped();
+           c = _next.fetch_add(1, std::memory_order_relaxed)) {
+        _fn(c);
+      }
+    } catch (...) {
+      error.capture();
+    }
+  }
+
+  ChunkError error;
+
+private:
+  const int _nChunks;
+  const ChunkFn& _fn;
+  std::atomic<int> _next{0};
+};
+
+// Runs fn(chunk) for every chunk on at most maxThreads threads of the host's multithread suite.
+static void hostMultiThread(int nChunks, unsigned int maxThreads, const ChunkFn& fn) {
+  HostParallelFor host(nChunks, fn);
+  host.multiThread(maxThreads);
+  host.error.rethrow();
+}
+
+struct RenderRequest;
+
+// What the render and isIdentity actions ask of the host (see renderAction and isIdentityAction,
+// which time each call under its action). SplitToneEffect answers through the OFX suites; the tests
+// answer from plain memory with simulated latencies.
+class RenderHost {
+public:
+  virtual ~RenderHost() {}
+  // Source and output at time, valid until the action returns; throws when there is nothing to grade.
+  virtual void fetchImages(double time, ImageView& src, ImageView& dst) = 0;
+  // Every param a render reads at time, and the CPUs it may use.
+  virtual void fetchRenderParams(double time, RenderRequest& req) = 0;
+  // Every param isIdentity reads at time.
+  virtual void fetchIdentityParams(double time, ParamsSnapshot& p, int& ditherMode, WedgeSetup& wedge) = 0;
+  // The host threading backend: same contract as parallelFor.
+  virtual void multiThread(int nChunks, unsigned int maxThreads, const ChunkFn& fn) = 0;
+  virtual bool aborted() const = 0;
+};
+
+// Calls fn(chunk) for every chunk in [0, nChunks) on at most maxThreads threads with the given
+// backend; backends not built in fall back to the host suite, asked through host when there is one.
+// An exception from fn stops the remaining chunks and is rethrown here once every thread is done.
+static void parallelFor(int backend, int nChunks, unsigned int maxThreads, const ChunkFn& fn,
+                        RenderHost* host = nullptr) {
+  if (nChunks <= 0) return;
+  maxThreads = std::max(1u, std::min(maxThreads, (unsigned int)nChunks));
+  if (maxThreads == 1) {
+    for (int c = 0; c < nChunks; ++c) fn(c);
+    return;
+  }
+  if (!threadingAvailable(backend)) backend = kThreadingHost;
+  switch (backend) {
+  case kThreadingPool:
+    WorkStealingPool::instance().run(nChunks, maxThreads, fn);
+    return;
+#ifdef _OPENMP
+  case kThreadingOpenMP:
+  {
+    ChunkError error;
+#pragma omp parallel for schedule(dynamic, 1) num_threads((int)maxThreads)
+    for (int c = 0; c < nChunks; ++c) {
+      if (error.stopped()) continue;
+      try {
+        fn(c);
+      } catch (...) {
+        error.capture();
+      }
+    }
+    error.rethrow();
+    return;
+  }
+#endif
+#ifdef SPLITTONE_WITH_TBB
+  case kThreadingTbb: {
+    tbb::task_arena arena((int)maxThreads);
+    arena.execute([&] {
+      tbb::parallel_for(tbb::blocked_range<int>(0, nChunks, 1), [&](const tbb::blocked_range<int>& r) {
+        for (int c = r.begin(); c < r.end(); ++c) fn(c);
+      });
+    });
+    return;
+  }
+#endif
+  default:
+    if (host) {
+      host->multiThread(nChunks, maxThreads, fn);
+    } else {
+      hostMultiThread(nChunks, maxThreads, fn);
+    }
+    return;
+  }
+}
+
+// Row chunks for a parallel-for over height rows: about four per thread so stealing has something
+// to balance, but never so small that the per-chunk setup shows.
+static const int kMinChunkRows = 16;
+
+static inline int chunkRows(int height, unsigned int threads) {
+  return std::max(kMinChunkRows, height / (int)std::max(1u, 4 * threads));
+}
+
+// Half-float curve tables
+// A half source has only 65536 possible values per channel, so the grade of each is tabulated by
+// running the render's own row kernel over all of them: lookups then give exactly the bits the
+// arithmetic path would (in every kernel and deterministic mode) for three loads per pixel. The
+// table holds halves when the output is half (384 KB) and floats otherwise.
+static const int kHalfValues = 65536;
+
+struct HalfCurveTable : std::enable_shared_from_this<HalfCurveTable> {
+  CurveSetup curve;
+  int kernel = kKernelReference;
+  bool deterministic = false;
+  bool halfOut = false;
+  std::vector<uint16_t> half;  // [channel][value], when halfOut
+  std::vector<float> single;   // [channel][value], otherwise
+  uint64_t key = 0;            // bakedCurveKey() of the above
+  mutable std::atomic<uint64_t> lastUse{0}; // BakedCurveStore tick of the latest lookup
+
+  std::size_t bytes() const { return half.size() * sizeof(uint16_t) + single.size() * sizeof(float); }
+
+  bool matches(const CurveSetup& c, const ParamsSnapshot& p, bool toHalf) const {
+    if (kernel != p.kernel || deterministic != p.deterministic || halfOut != toHalf) return false;
+    if (curve.shadowEnd != c.shadowEnd || curve.highlightStart != c.highlightStart) return false;
+    for (int i = 0; i < 3; ++i) {
+      if (curve.pShadow[i] != c.pShadow[i] || curve.pHighlight[i] != c.pHighlight[i]) return false;
+    }
+    return true;
+  }
+};
+
+// Content address of a table: the bits of everything it is built from. Grades that resolve to the
+// same curve (another preset with the same boundaries, say) share one.
+static inline uint64_t bakedCurveKey(const CurveSetup& c, const ParamsSnapshot& p, bool halfOut) {
+  const float values[8] = {c.shadowEnd, c.highlightStart, c.pShadow[0], c.pShadow[1], c.pShadow[2],
+                           c.pHighlight[0], c.pHighlight[1], c.pHighlight[2]};
+  const int32_t modes[3] = {p.kernel, p.deterministic ? 1 : 0, halfOut ? 1 : 0};
+  return hashBytes(hashBytes(kHashSeed, values, sizeof(values)), modes, sizeof(modes));
+}
+
+// Builds the table in chunks of 4096 values on up to threads threads of the given backend.
+static std::shared_ptr<HalfCurveTable> buildHalfCurveTable(const ParamsSnapshot& p, bool halfOut,
+                                                           int backend, unsigned int threads,
+                                                           RenderHost* host = nullptr) {
+  std::shared_ptr<HalfCurveTable> t = std::make_shared<HalfCurveTable>();
+  t->curve = makeCurveSetup(p);
+  t->key = bakedCurveKey(t->curve, p, halfOut);
+  t->kernel = p.kernel;
+  t->deterministic = p.deterministic;
+  t->halfOut = halfOut;
+  if (halfOut) {
+    t->half.resize(3 * (std::size_t)kHalfValues);
+  } else {
+    t->single.resize(3 * (std::size_t)kHalfValues);
+  }
+
+  const RowKernelFn kernel = selectRowKernel(p);
+  const int chunk = 4096;
+  parallelFor(backend, kHalfValues / chunk, threads, [&](int ci) {
+    ScratchArena& arena = ScratchArena::forThisThread();
+    ScratchScope scratchScope(arena);
+    float* px = arena.allocArray<float>((std::size_t)chunk * 4);
+    const int h0 = ci * chunk;
+    for (int i = 0; i < chunk; ++i) {
+      const float v = halfToFloat((uint16_t)(h0 + i));
+      px[4 * i] = px[4 * i + 1] = px[4 * i + 2] = v;
+      px[4 * i + 3] = 1.0f;
+    }
+    kernel(px, px, chunk, t->curve);
+    for (int ch = 0; ch < 3; ++ch) {
+      for (int i = 0; i < chunk; ++i) {
+        const std::size_t at = (std::size_t)ch * kHalfValues + (std::size_t)(h0 + i);
+        if (halfOut) {
+          t->half[at] = floatToHalf(px[4 * i + ch]);
+        } else {
+          t->single[at] = px[4 * i + ch];
+        }
+      }
+    }
+  }, host);
+  return t;
+}
+
+// Process-wide store of tables shared by every instance, so a timeline of instances with the same
+// grade holds one copy. Lookups are lock-free: a table is found through a direct-mapped slot array
+// and taken with shared_from_this, while a reader count keeps evicted tables alive until no lookup
+// can still be holding a raw pointer to them. Building, publishing and eviction take the mutex.
+// Past kMaxBytes the least recently used tables leave the store; renders still using one keep it
+// alive through their reference.
+class BakedCurveStore {
+public:
+  static const std::size_t kMaxBytes = 64u << 20;
+  static const int kSlots = 256;
+
+  static BakedCurveStore& instance() {
+    static BakedCurveStore store;
+    return store;
+  }
+
+  std::shared_ptr<const HalfCurveTable> get(const ParamsSnapshot& p, bool halfOut, int backend, unsigned int threads,
+                                            RenderHost* host = nullptr) {
+    const CurveSetup c = makeCurveSetup(p);
+    const uint64_t key = bakedCurveKey(c, p, halfOut);
+    if (std::shared_ptr<const HalfCurveTable> t = find(key, c, p, halfOut)) {
+      _hits.fetch_add(1, std::memory_order_relaxed);
+      return t;
+    }
+
+    {
+      // Listed but not in its slot (another table took it): repoint the slot.
+      std::lock_guard<std::mutex> lock(_mutex);
+      for (const auto& t : _tables) {
+        if (t->key == key && t->matches(c, p, halfOut)) {
+          _slots[key % kSlots].store(t.get());
+          t->lastUse.store(_tick.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+          _hits.fetch_add(1, std::memory_order_relaxed);
+          return t;
+        }
+      }
+    }
+
+    // Built outside the lock; two renders racing on a new grade both build it and the first one
+    // published is kept.
+    std::shared_ptr<HalfCurveTable> built = buildHalfCurveTable(p, halfOut, backend, threads, host);
+    _builds.fetch_add(1, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const auto& t : _tables) {
+      if (t->key == key && t->matches(c, p, halfOut)) return t;
+    }
+    built->lastUse.store(_tick.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+    _tables.push_back(built);
+    _bytes += built->bytes();
+    _slots[key % kSlots].store(built.get());
+    evict(built.get());
+    return built;
+  }
+
+  // Drops every table; renders still holding one keep it. For tests that change the CPU dispatch
+  // and need tables baked again.
+  void clear() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const auto& t : _tables) {
+      const HalfCurveTable* expected = t.get();
+      _slots[t->key % kSlots].compare_exchange_strong(expected, nullptr);
+      _retired.push_back(t);
+    }
+    _tables.clear();
+    _bytes = 0;
+    releaseRetired();
+  }
+
+  // Tables held, their size, and lookups served from the store vs tables built.
+  void usage(std::size_t& tables, std::size_t& bytes, uint64_t& hits, uint64_t& builds) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    tables = _tables.size();
+    bytes = _bytes;
+    hits = _hits.load(std::memory_order_relaxed);
+    builds = _builds.load(std::memory_order_relaxed);
+  }
+
+private:
+  BakedCurveStore() {
+    for (int i = 0; i < kSlots; ++i) _slots[i].store(nullptr, std::memory_order_relaxed);
+  }
+
+  std::shared_ptr<const HalfCurveTable> find(uint64_t key, const CurveSetup& c, const ParamsSnapshot& p, bool halfOut) {
+    std::shared_ptr<const HalfCurveTable> found;
+    _readers.fetch_add(1);
+    const HalfCurveTable* t = _slots[key % kSlots].load();
+    if (t && t->key == key && t->matches(c, p, halfOut)) {
+      found = t->shared_from_this();
+      t->lastUse.store(_tick.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    // The last reader out releases tables retired while it was looking, so they do not wait for
+    // the next eviction.
+    if (_readers.fetch_sub(1) == 1 && _retiredPending.load()) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      releaseRetired();
+    }
+    return found;
+  }
+
+  // Under the mutex. An evicted table leaves its slot first; it is only released once the reader
+  // count has been zero after that, since a lookup that loaded the slot before was already counted.
+  void evict(const HalfCurveTable* keep) {
+    while (_bytes > kMaxBytes && _tables.size() > 1) {
+      std::size_t oldest = 0;
+      uint64_t oldestUse = std::numeric_limits<uint64_t>::max();
+      for (std::size_t i = 0; i < _tables.size(); ++i) {
+        const uint64_t use = _tables[i]->lastUse.load(std::memory_order_relaxed);
+        if (_tables[i].get() != keep && use < oldestUse) {
+          oldest = i;
+          oldestUse = use;
+        }
+      }
+      std::shared_ptr<HalfCurveTable> t = _tables[oldest];
+      _tables.erase(_tables.begin() + (std::ptrdiff_t)oldest);
+      _bytes -= t->bytes();
+      const HalfCurveTable* expected = t.get();
+      _slots[t->key % kSlots].compare_exchange_strong(expected, nullptr);
+      _retired.push_back(t);
+    }
+    releaseRetired();
+  }
+
+  // Under the mutex. The pending flag is raised before the reader count is read: a reader leaving
+  // in between then either sees the flag, or has left before the count was read as zero here.
+  void releaseRetired() {
+    if (_retired.empty()) return;
+    _retiredPending.store(true);
+    if (_readers.load() == 0) {
+      _retired.clear();
+      _retiredPending.store(false);
+    }
+  }
+
+  std::mutex _mutex;
+  std::vector<std::shared_ptr<HalfCurveTable>> _tables;
+  std::vector<std::shared_ptr<HalfCurveTable>> _retired;
+  std::size_t _bytes = 0;
+  std::atomic<const HalfCurveTable*> _slots[kSlots];
+  std::atomic<int> _readers{0};
+  std::atomic<bool> _retiredPending{false}; // _retired is not empty
+  std::atomic<uint64_t> _tick{1};
+  std::atomic<uint64_t> _hits{0};
+  std::atomic<uint64_t> _builds{0};
+};
+
+// Hardware performance counters (Linux perf_event_open)
+// Each processing thread lazily opens one counter group for itself and keeps it for its lifetime;
+// start/stop around a slice of work are then just two ioctls and a read.
+class HwCounters {
+public:
+  static HwCounters& forThisThread() {
+    thread_local HwCounters counters;
+    return counters;
+  }
+
+  bool start() {
+#if defined(__linux__)
+    if (!open()) return false;
+    ioctl(_fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(_fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  bool stop(HwSample& out) {
+#if defined(__linux__)
+    if (_fd[0] < 0) return false;
+    ioctl(_fd[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    struct { uint64_t nr; uint64_t values[kEvents]; } data;
+    if (read(_fd[0], &data, sizeof(data)) != (ssize_t)sizeof(data) || data.nr != kEvents) return false;
+    out.cycles = data.values[0];
+    out.instructions = data.values[1];
+    out.llcMisses = data.values[2];
+    out.branchMisses = data.values[3];
+    return true;
+#else
+    (void)out;
+    return false;
+#endif
+  }
+
+  ~HwCounters() {
+#if defined(__linux__)
+    for (int i = kEvents - 1; i >= 0; --i) if (_fd[i] >= 0) close(_fd[i]);
+#endif
+  }
+
+private:
+  static const int kEvents = 4;
+
+  HwCounters() = default;
+
+#if defined(__linux__)
+  bool open() {
+    if (_tried) return _fd[0] >= 0;
+    _tried = true;
+
+    const uint64_t configs[kEvents] = {
+      PERF_COUNT_HW_CPU_CYCLES,
+      PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_MISSES,   // last-level cache misses
+      PERF_COUNT_HW_BRANCH_MISSES
+    };
+    for (int i = 0; i < kEvents; ++i) {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = configs[i];
+      attr.disabled = (i == 0);
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP;
+      _fd[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, i == 0 ? -1 : _fd[0], 0);
+      if (_fd[i] < 0) {
+        // Counters are all-or-nothing (VMs and perf_event_paranoid often hide some of them).
+        for (int j = i - 1; j >= 0; --j) { close(_fd[j]); _fd[j] = -1; }
+        return false;
+      }
+    }
+    return true;
+  }
+
+  int _fd[kEvents] = {-1, -1, -1, -1};
+  bool _tried = false;
+#endif
+};
+
+// Upper edge (in microseconds) of the latency bucket holding quantile q.
+static inline double latencyQuantileUs(const StatsTotals& t, double q) {
+  if (!t.renders) return 0.0;
+  const uint64_t target = (uint64_t)std::ceil(q * (double)t.renders);
+  uint64_t seen = 0;
+  for (int b = 0; b < kLatencyBuckets; ++b) {
+    seen += t.latency[b];
+    if (seen >= target) return (double)(1ull << b);
+  }
+  return (double)(1ull << (kLatencyBuckets - 1));
+}
+
+// hwCounters: whether "Hardware Counters" is on, to explain an empty counter section.
+static inline std::string formatStatsSummary(const StatsTotals& t, bool hwCounters) {
+  std::ostringstream os;
+  os.setf(std::ios::fixed);
+  os.precision(2);
+  const double seconds = (double)t.renderNanos * 1e-9;
+  os << "Split Tone v2 performance\n"
+     << "Renders: " << t.renders << " (identity short-circuits: " << t.identities << ")\n"
+     << "Pixels processed: " << t.pixels << "\n"
+     << "Fast-path pixels: " << t.fastPathPixels;
+  if (t.pixels) os << " (" << 100.0 * (double)t.fastPathPixels / (double)t.pixels << "%)";
+  os << "\n";
+  if (t.transparentPixels) {
+    os << "Transparent pixels skipped: " << t.transparentPixels << " ("
+       << 100.0 * (double)t.transparentPixels / (double)t.pixels << "%)\n";
+  }
+  if (t.renders) {
+    os << "Mean render: " << seconds * 1e3 / (double)t.renders << " ms"
+       << " (p50 <= " << latencyQuantileUs(t, 0.50) * 1e-3
+       << " ms, p90 <= " << latencyQuantileUs(t, 0.90) * 1e-3
+       << " ms, p99 <= " << latencyQuantileUs(t, 0.99) * 1e-3 << " ms)\n";
+  }
+  if (seconds > 0.0) os << "Throughput: " << (double)t.pixels / seconds * 1e-6 << " Mpix/s\n";
+  os << "Scratch arena blocks allocated during renders: " << t.scratchAllocs << "\n";
+  if (t.renders) {
+    os << "Threads per render: " << (double)t.workerThreads / (double)t.renders
+       << " (inline on the render thread: " << t.inlineRenders << ")\n";
+  }
+  if (t.lutRenders) {
+    std::size_t lutFrames = 0, lutBytes = 0;
+    LutFrameStore::instance().usage(lutFrames, lutBytes);
+    os << "Paused-frame LUT renders: " << t.lutRenders << " (coordinates built: " << t.lutBuilds << "; "
+       << lutFrames << " frames, " << (double)lutBytes / (1 << 20) << " MB held by all instances)\n";
+  }
+  if (t.staticTiles) {
+    std::size_t tileFrames = 0, tileBytes = 0;
+    StaticTileStore::instance().usage(tileFrames, tileBytes);
+    os << "Static tiles reused: " << t.reusedTiles << " of " << t.staticTiles << " (" << tileFrames << " frames, "
+       << (double)tileBytes / (1 << 20) << " MB held by all instances)\n";
+  }
+  std::size_t bakedTables = 0, bakedBytes = 0;
+  uint64_t bakedHits = 0, bakedBuilds = 0;
+  BakedCurveStore::instance().usage(bakedTables, bakedBytes, bakedHits, bakedBuilds);
+  if (bakedHits || bakedBuilds) {
+    os << "Baked half-float curves (all instances): " << bakedTables << " held, "
+       << (double)bakedBytes / (1 << 20) << " MB, " << bakedHits << " lookups shared, " << bakedBuilds << " built\n";
+  }
+
+  uint64_t renderHostNanos = 0;
+  for (int a = 0; a < kActionCount; ++a) {
+    const uint64_t actions = a == kActionRender ? t.renders : t.hostCalls[a][kHostGetParams];
+    if (!actions) continue;
+    os << "Host calls per " << kActionNames[a] << " (calls x mean us):";
+    const char* sep = " ";
+    for (int c = 0; c < kHostCallCount; ++c) {
+      if (!t.hostCalls[a][c]) continue;
+      os << sep << kHostCallNames[c] << " " << (double)t.hostCalls[a][c] / (double)actions
+         << " x " << (double)t.hostNanos[a][c] * 1e-3 / (double)t.hostCalls[a][c];
+      sep = ", ";
+      if (a == kActionRender) renderHostNanos += t.hostNanos[a][c];
+    }
+    os << "\n";
+  }
+  if (t.renderNanos) {
+    os << "Host overhead: " << 100.0 * (double)renderHostNanos / (double)t.renderNanos << "% of render time\n";
+  }
+
+  if (t.counterPixels) {
+    const double px = (double)t.counterPixels;
+    os << "Cycles/pixel: " << (double)t.cycles / px
+       << ", instructions/pixel: " << (double)t.instructions / px
+       << ", IPC: " << (t.cycles ? (double)t.instructions / (double)t.cycles : 0.0) << "\n"
+       << "LLC misses/kpix: " << 1e3 * (double)t.llcMisses / px
+       << ", branch mispredicts/kpix: " << 1e3 * (double)t.branchMisses / px << "\n";
+  } else if (hwCounters) {
+    os << "Hardware counters unavailable (not Linux, or blocked by perf_event_paranoid)\n";
+  }
+
+  // The memory ceiling to hold this against is measured by SplitToneBench, away from the host.
+  if (t.kernelNanos && t.kernelBytes && t.pixels) {
+    const double bytesPerPixel = (double)t.kernelBytes / (double)t.pixels;
+    os << "Kernel bandwidth: " << (double)t.kernelBytes / (double)t.kernelNanos << " GB/s ("
+       << bytesPerPixel << " bytes/pixel read and written)";
+    if (t.counterPixels) {
+      os << ", " << (double)t.instructions / ((double)t.counterPixels * bytesPerPixel) << " instr/byte";
+    }
+    os << "\n";
+  }
+  return os.str();
+}
+
+static inline std::string formatStatsJson(const StatsTotals& t) {
+  std::ostringstream os;
+  os << "{\n"
+     << "  \"plugin\": \"" << kPluginIdentifier << "\",\n"
+     << "  \"version\": \"" << kPluginVersionMajor << "." << kPluginVersionMinor << "\",\n"
+     << "  \"renders\": " << t.renders << ",\n"
+     << "  \"identities\": " << t.identities << ",\n"
+     << "  \"pixels\": " << t.pixels << ",\n"
+     << "  \"fastPathPixels\": " << t.fastPathPixels << ",\n"
+     << "  \"transparentPixels\": " << t.transparentPixels << ",\n"
+     << "  \"renderNanos\": " << t.renderNanos << ",\n"
+     << "  \"kernelNanos\": " << t.kernelNanos << ",\n"
+     << "  \"kernelBytes\": " << t.kernelBytes << ",\n"
+     << "  \"scratchAllocs\": " << t.scratchAllocs << ",\n"
+     << "  \"workerThreads\": " << t.workerThreads << ",\n"
+     << "  \"inlineRenders\": " << t.inlineRenders << ",\n"
+     << "  \"lutRenders\": " << t.lutRenders << ",\n"
+     << "  \"lutBuilds\": " << t.lutBuilds << ",\n"
+     << "  \"staticTiles\": " << t.staticTiles << ",\n"
+     << "  \"reusedTiles\": " << t.reusedTiles << ",\n"
+     << "  \"counterPixels\": " << t.counterPixels << ",\n"
+     << "  \"cycles\": " << t.cycles << ",\n"
+     << "  \"instructions\": " << t.instructions << ",\n"
+     << "  \"llcMisses\": " << t.llcMisses << ",\n"
+     << "  \"branchMisses\": " << t.branchMisses << ",\n"
+     << "  \"hostCalls\": {";
+  for (int a = 0; a < kActionCount; ++a) {
+    os << (a ? ", " : "") << "\"" << kActionNames[a] << "\": {";
+    for (int c = 0; c < kHostCallCount; ++c) {
+      os << (c ? ", " : "") << "\"" << kHostCallNames[c] << "\": {\"calls\": " << t.hostCalls[a][c]
+         << ", \"nanos\": " << t.hostNanos[a][c] << "}";
+    }
+    os << "}";
+  }
+  os << "},\n"
+     << "  \"latencyHistogramUs\": [";
+  for (int b = 0; b < kLatencyBuckets; ++b) {
+    os << (b ? ", " : "") << "{\"le\": " << (1ull << b) << ", \"count\": " << t.latency[b] << "}";
+  }
+  os << "]\n}\n";
+  return os.str();
+}
+
+// Curve overlay
+// Drawn after grading by rasterizing each line along its path, so only pixels near a line are
+// touched and the cost grows with the frame's width and height rather than its area. Coverage is
+// anti-aliased: full within halfWidth - 0.5 pixels of the line, fading out by halfWidth + 0.5.
+// Pixel (x, y) sits at integer coordinates, as in the DCTL's x/Width, 1 - y/Height mapping.
+struct OverlayBand {
+  char* base = nullptr; // address of pixel (bx, by)
+  std::ptrdiff_t rowBytes = 0;
+  int bx = 0, by = 0;
+  int x1 = 0, x2 = 0, y1 = 0, y2 = 0; // clip rectangle, half-open
+
+  float* pixel(int x, int y) const {
+    return (float*)(base + (std::ptrdiff_t)(y - by) * rowBytes + (std::ptrdiff_t)(x - bx) * 4 * (std::ptrdiff_t)sizeof(float));
+  }
+};
+
+static inline float lineCoverage(float distance, float halfWidth) {
+  return clampf(halfWidth + 0.5f - distance, 0.0f, 1.0f);
+}
+
+static inline float segmentDistance(float px, float py, float ax, float ay, float bx, float by) {
+  const float dx = bx - ax, dy = by - ay;
+  const float len2 = dx * dx + dy * dy;
+  const float t = len2 > 0.0f ? clampf(((px - ax) * dx + (py - ay) * dy) / len2, 0.0f, 1.0f) : 0.0f;
+  const float ex = px - (ax + t * dx), ey = py - (ay + t * dy);
+  return std::sqrt(ex * ex + ey * ey);
+}
+
+// Curve values of the n columns from x of an image spanning columns x1 to x1 + w, 3 per column.
+// Deterministic renders evaluate them with the portable pow, like their row kernels, so the
+// overlay does not depend on the machine's libm.
+template <class Pow>
+static void curveColumnsWith(float* cols, int x, int n, int x1, int w, const CurveSetup& c) {
+  for (int i = 0; i < n; ++i) {
+    const float xNorm = (float)(x + i - x1) / (float)w;
+    for (int ch = 0; ch < 3; ++ch) {
+      cols[i * 3 + ch] = applyCurveWith<Pow>(xNorm, c.shadowEnd, c.highlightStart, c.pShadow[ch], c.pHighlight[ch]);
+    }
+  }
+}
+
+static void curveColumns(float* cols, int x, int n, int x1, int w, const CurveSetup& c, bool deterministic) {
+  if (deterministic) curveColumnsWith<PortablePow>(cols, x, n, x1, w, c);
+  else curveColumnsWith<StdPow>(cols, x, n, x1, w, c);
+}
+
+struct SolidPaint {
+  float r, g, b;
+  void operator()(float* px, float a) const {
+    px[0] += a * (r - px[0]);
+    px[1] += a * (g - px[1]);
+    px[2] += a * (b - px[2]);
+  }
+};
+
+// The diagonal reference line lightens what is underneath instead of replacing it.
+struct LightenPaint {
+  void operator()(float* px, float a) const {
+    for (int ch = 0; ch < 3; ++ch) px[ch] += a * ((px[ch] * 0.4f + 0.6f) - px[ch]);
+  }
+};
+
+// Polyline through (x, yAt(x)) for every column; each pixel is covered by its distance to the two
+// segments meeting at its column, so steep curves stay connected and keep their width. Either
+// segment can come within reach anywhere along its height, so the whole of it is scanned.
+template <class YAt, class Paint>
+static void drawPolyline(const OverlayBand& band, const YAt& yAt, float halfWidth, const Paint& paint) {
+  for (int x = band.x1; x < band.x2; ++x) {
+    const float y0 = yAt(x - 1), y1 = yAt(x), y2 = yAt(x + 1);
+    const float lo = std::min(y1, std::min(y0, y2));
+    const float hi = std::max(y1, std::max(y0, y2));
+    if (!(lo == lo) || !(hi == hi)) continue; // NaN curve value: nothing to draw
+    const int ya = std::max(band.y1, (int)std::ceil(lo - halfWidth - 0.5f));
+    const int yb = std::min(band.y2 - 1, (int)std::floor(hi + halfWidth + 0.5f));
+    for (int y = ya; y <= yb; ++y) {
+      const float d = std::min(segmentDistance((float)x, (float)y, (float)(x - 1), y0, (float)x, y1),
+                               segmentDistance((float)x, (float)y, (float)x, y1, (float)(x + 1), y2));
+      const float a = lineCoverage(d, halfWidth);
+      if (a > 0.0f) paint(band.pixel(x, y), a);
+    }
+  }
+}
+
+template <class Paint>
+static void drawVerticalLine(const OverlayBand& band, float x0, float halfWidth, const Paint& paint) {
+  const int xa = std::max(band.x1, (int)std::ceil(x0 - halfWidth - 0.5f));
+  const int xb = std::min(band.x2 - 1, (int)std::floor(x0 + halfWidth + 0.5f));
+  for (int x = xa; x <= xb; ++x) {
+    const float a = lineCoverage(std::fabs((float)x - x0), halfWidth);
+    if (a <= 0.0f) continue;
+    for (int y = band.y1; y < band.y2; ++y) paint(band.pixel(x, y), a);
+  }
+}
+
+template <class Paint>
+static void drawHorizontalLine(const OverlayBand& band, float y0, float halfWidth, const Paint& paint) {
+  const int ya = std::max(band.y1, (int)std::ceil(y0 - halfWidth - 0.5f));
+  const int yb = std::min(band.y2 - 1, (int)std::floor(y0 + halfWidth + 0.5f));
+  for (int y = ya; y <= yb; ++y) {
+    const float a = lineCoverage(std::fabs((float)y - y0), halfWidth);
+    if (a <= 0.0f) continue;
+    for (int x = band.x1; x < band.x2; ++x) paint(band.pixel(x, y), a);
+  }
+}
+
+// RGBA processor
+// Grades one render window between two image views on any threading backend. Nothing here calls
+// the host outside the host backend, so tests and tools drive it with plain memory.
+class SplitToneProcessor {
+public:
+  void setRenderWindow(const OfxRectI& window) { _renderWindow = window; }
+
+  // Both views must outlive process(); rows are addressed through them rather than the host images.
+  void setImages(const ImageView* src, const ImageView* dst) {
+    _src = src;
+    _dst = dst;
+  }
+  void setParams(const ParamsSnapshot& p) { _p = p; }
+  void setStats(RenderStats* stats) { _stats = stats; }
+  void setHardwareCounters(bool enabled) { _hwCounters = enabled; }
+  void setScratch(ScratchArena* arena) { _scratch = arena; }
+  // Asked for host threads instead of the OFX suite (see RenderHost).
+  void setHost(RenderHost* host) { _host = host; }
+
+  // Grade through the paused-frame LUT: coords holds 3 per render-window pixel, read when build is
+  // false and filled in (then read back) when it is true.
+  void setLut(const CurveLut* lut, uint32_t* coords, bool build) {
+    _lut = lut;
+    _lutCoords = coords;
+    _lutBuild = build;
+  }
+
+  // Grade half sources by table lookup; must match this render's params. A half-output table is
+  // only used for half outputs without the burned-in curve, which blends before rounding.
+  void setHalfTable(const HalfCurveTable* table) { _halfTable = table; }
+
+  // Grade a wedge contact sheet of count variants instead of the image (see processWedge).
+  void setWedge(const CurveSetup* variants, int count) {
+    _wedge = variants;
+    _wedgeCount = count;
+  }
+
+  // Quantize color with a dither pattern while storing (see storeRowDithered).
+  void setDither(const DitherSetup& d) { _dither = d; }
+
+  // Copy the tiles of frame whose source is unchanged and grade the rest, storing them back into
+  // frame (see StaticTileStore); frame must belong to this render's key and grade.
+  void setStaticTiles(StaticTileFrame* frame) { _tiles = frame; }
+
+  // Grades the render window in row chunks on at most maxThreads threads of the given backend; 1 runs
+  // inline on the calling thread.
+  void process(unsigned int maxThreads, int backend) {
+    if (!_src || !_dst) return;
+    fillCurveColumns();
+    _dispatchStart = steadyNanos();
+    if (_wedge) {
+      processWedge(maxThreads, backend);
+    } else if (_tiles) {
+      processStaticTiles(maxThreads, backend);
+    } else if (maxThreads <= 1) {
+      processWindow(_renderWindow);
+    } else {
+      const int height = _renderWindow.y2 - _renderWindow.y1;
+      const int rows = chunkRows(height, maxThreads);
+      parallelFor(backend, (height + rows - 1) / rows, maxThreads, [&](int chunk) {
+        OfxRectI band = _renderWindow;
+        band.y1 = _renderWindow.y1 + chunk * rows;
+        band.y2 = std::min(_renderWindow.y2, band.y1 + rows);
+        processWindow(band);
+      }, _host);
+    }
+  }
+
+  // Worker time per pixel of the process() call, summed over threads; 0 if nothing ran.
+  double workNanosPerPixel() const {
+    const uint64_t px = _workPixels.load(std::memory_order_relaxed);
+    return px ? (double)_workNanos.load(std::memory_order_relaxed) / (double)px : 0.0;
+  }
+
+  // Time process() spent in the threading backend rather than in the workers: from the end of its
+  // setup to the first worker starting, plus from the last worker finishing to processEnd.
+  uint64_t dispatchNanos(uint64_t processEnd) const {
+    const uint64_t first = _firstWorkerStart.load(std::memory_order_relaxed);
+    const uint64_t last = _lastWorkerEnd.load(std::memory_order_relaxed);
+    if (!_dispatchStart || first < _dispatchStart || last > processEnd || last < first) return 0;
+    return (first - _dispatchStart) + (processEnd - last);
+  }
+
+  // The overlay curves only depend on the column, so evaluate them once per column, including one
+  // column past each side of the render window for the segments that leave it.
+  void fillCurveColumns() {
+    _curveCols = nullptr;
+    if (!_p.burnInCurve || !_dst || !_scratch) return;
+
+    const OfxRectI bnd = _dst->getBounds();
+    const int w = bnd.x2 - bnd.x1;
+    const int n = _renderWindow.x2 - _renderWindow.x1;
+    if (w <= 0 || n <= 0) return;
+
+    const CurveSetup c = makeCurveSetup(_p);
+    float* cols = _scratch->allocArray<float>((std::size_t)(n + 2) * 3);
+    curveColumns(cols, _renderWindow.x1 - 1, n + 2, bnd.x1, w, c, _p.deterministic);
+    _curveCols = cols;
+  }
+
+private:
+  // One worker's part of the render window.
+  void processWindow(OfxRectI procWindow) {
+    const uint64_t workStart = steadyNanos();
+    const ImageView* src = _src;
+    const ImageView* dst = _dst;
+    if (!src || !dst) return;
+
+    const CurveSetup c = makeCurveSetup(_p);
+    const RowKernelFn kernel = selectRowKernel(_p);
+
+    // Only pixels covered by both images are written (src may be a smaller tile).
+    const OfxRectI bnd = dst->getBounds();
+    const OfxRectI srcBnd = src->getBounds();
+    const int x1 = std::max(procWindow.x1, std::max(srcBnd.x1, bnd.x1));
+    const int x2 = std::min(procWindow.x2, std::min(srcBnd.x2, bnd.x2));
+
+    uint64_t pixels = 0;
+    uint64_t fastPathPixels = 0;
+    uint64_t transparentPixels = 0;
+
+    HwCounters* hw = nullptr;
+    if (_hwCounters && _stats) {
+      hw = &HwCounters::forThisThread();
+      if (!hw->start()) hw = nullptr;
+    }
+
+    const int n = x2 - x1;
+    const int lutStride = _renderWindow.x2 - _renderWindow.x1;
+
+    // One float row of the window at y, src may equal dst.
+    auto gradeRow = [&](const float* srcRow, float* dstRow, int y) -> int {
+      if (!_lut) return gradeSparseRow(kernel, srcRow, dstRow, n, c, transparentPixels);
+      uint32_t* coords = _lutCoords + 3 * ((std::size_t)(y - _renderWindow.y1) * (std::size_t)lutStride +
+                                           (std::size_t)(x1 - _renderWindow.x1));
+      if (_lutBuild) lutCoordinatesRow(srcRow, coords, n, c);
+      return gatherRow(srcRow, dstRow, coords, n, *_lut);
+    };
+
+    const OFX::BitDepthEnum srcDepth = src->getPixelDepth();
+    const OFX::BitDepthEnum dstDepth = dst->getPixelDepth();
+    const bool dither = _dither.mode != kDitherOff;
+    const HalfCurveTable* halfTable = srcDepth == OFX::eBitDepthHalf && !_lut && _halfTable &&
+                                      (!_halfTable->halfOut || (dstDepth == OFX::eBitDepthHalf && !_curveCols && !dither))
+                                      ? _halfTable : nullptr;
+    if (srcDepth == OFX::eBitDepthFloat && dstDepth == OFX::eBitDepthFloat && !dither) {
+      for (int y = procWindow.y1; y < procWindow.y2 && n > 0; ++y) {
+        const float* srcRow = (const float*)src->getPixelAddress(x1, y);
+        float* dstRow = (float*)dst->getPixelAddress(x1, y);
+        if (!srcRow || !dstRow) continue;
+
+        pixels += (uint64_t)n;
+        fastPathPixels += (uint64_t)gradeRow(srcRow, dstRow, y);
+      }
+
+      if (_curveCols && n > 0) {
+        OfxRectI band = procWindow;
+        band.x1 = x1;
+        band.x2 = x2;
+        drawOverlay(*dst, band, c);
+      }
+    } else if (n > 0 && halfTable && halfTable->halfOut) {
+      // Half to half: three lookups per pixel and a copied alpha, nothing staged. Linear pixels
+      // are not counted on the table paths.
+      const uint16_t* t = halfTable->half.data();
+      for (int y = procWindow.y1; y < procWindow.y2; ++y) {
+        const uint16_t* s = (const uint16_t*)src->getPixelAddress(x1, y);
+        uint16_t* d = (uint16_t*)dst->getPixelAddress(x1, y);
+        if (!s || !d) continue;
 
-static inline float clampf(float v, float lo, float hi) {
-  return std::max(lo, std::min(hi, v));
-}
+        for (int i = 0; i < n; ++i, s += 4, d += 4) {
+          const uint16_t a = s[3];
+          d[0] = t[s[0]];
+          d[1] = t[kHalfValues + s[1]];
+          d[2] = t[2 * kHalfValues + s[2]];
+          d[3] = a;
+        }
+        pixels += (uint64_t)n;
+      }
+    } else if (n > 0) {
+      // Load kStageRows rows as float, grade them in place, burn in the overlay, store (dithered
+      // outputs of any depth come this way, so the overlay is quantized with the rest).
+      ScratchArena& arena = ScratchArena::forThisThread();
+      ScratchScope scratchScope(arena);
+      float* stage = arena.allocArray<float>((std::size_t)n * 4 * kStageRows);
+      void* dstRows[kStageRows];
+      for (int y0 = procWindow.y1; y0 < procWindow.y2; y0 += kStageRows) {
+        const int rows = std::min(kStageRows, procWindow.y2 - y0);
+        for (int r = 0; r < rows; ++r) {
+          const void* srcRow = src->getPixelAddress(x1, y0 + r);
+          void* dstRow = dst->getPixelAddress(x1, y0 + r);
+          dstRows[r] = srcRow ? dstRow : nullptr;
+          if (!dstRows[r]) continue;
 
-static inline float getMiddleGray(int preset) {
-  static const float mg[20] = {
-    0.180f, // Linear
-    0.413f, // ACEScc
-    0.413f, // ACEScct
-    0.391f, // ARRI LogC3
-    0.278f, // ARRI LogC4
-    0.383f, // BMD Film Gen5
-    0.312f, // Canon Log
-    0.387f, // Canon Log2
-    0.330f, // Canon Log3
-    0.336f, // DaVinci Intermediate
-    0.398f, // DJI D-Log
-    0.459f, // Fujifilm F-Log
-    0.391f, // Fujifilm F-Log2
-    0.458f, // Gamma 2.2
-    0.489f, // Gamma 2.4
-    0.363f, // Nikon N-Log
-    0.423f, // Panasonic V-Log
-    0.333f, // RED Log3G10
-    0.410f, // Sony S-Log3
-    0.488f  // Apple Log
+          float* row = stage + (std::size_t)r * n * 4;
+          pixels += (uint64_t)n;
+          if (halfTable) {
+            lookupHalfRow(*halfTable, (const uint16_t*)srcRow, row, n);
+            continue;
+          }
+          loadRow(srcDepth, srcRow, row, n);
+          fastPathPixels += (uint64_t)gradeRow(row, row, y0 + r);
+        }
+
+        if (_curveCols) {
+          OverlayBand band;
+          band.base = (char*)stage;
+          band.rowBytes = (std::ptrdiff_t)n * 4 * (std::ptrdiff_t)sizeof(float);
+          band.bx = x1;
+          band.by = y0;
+          const OfxRectI clip = {x1, y0, x2, y0 + rows};
+          drawOverlay(dst->getBounds(), band, clip, c);
+        }
+
+        for (int r = 0; r < rows; ++r) {
+          if (!dstRows[r]) continue;
+          if (dither) {
+            storeRowDithered(_dither, dstDepth, stage + (std::size_t)r * n * 4, dstRows[r], n, x1, y0 + r);
+          } else {
+            storeRow(dstDepth, stage + (std::size_t)r * n * 4, dstRows[r], n);
+          }
+        }
+      }
+    }
+
+    if (hw) {
+      HwSample sample;
+      if (hw->stop(sample)) _stats->addCounters(pixels, sample);
+    }
+    if (_stats) _stats->addPixels(pixels, fastPathPixels, transparentPixels);
+    addWork(workStart, pixels);
+  }
+
+  // Books one worker's run from workStart to now: its time and pixels, and the span of all workers
+  // that dispatchNanos leaves out.
+  void addWork(uint64_t workStart, uint64_t pixels) {
+    const uint64_t workEnd = steadyNanos();
+    _workNanos.fetch_add(workEnd - workStart, std::memory_order_relaxed);
+    _workPixels.fetch_add(pixels, std::memory_order_relaxed);
+    uint64_t first = _firstWorkerStart.load(std::memory_order_relaxed);
+    while (workStart < first && !_firstWorkerStart.compare_exchange_weak(first, workStart, std::memory_order_relaxed)) {}
+    uint64_t last = _lastWorkerEnd.load(std::memory_order_relaxed);
+    while (workEnd > last && !_lastWorkerEnd.compare_exchange_weak(last, workEnd, std::memory_order_relaxed)) {}
+  }
+
+  // n half RGBA pixels to graded float pixels through a float table.
+  static void lookupHalfRow(const HalfCurveTable& table, const uint16_t* s, float* d, int n) {
+    const float* t = table.single.data();
+    for (int i = 0; i < n; ++i, s += 4, d += 4) {
+      const uint16_t a = s[3];
+      d[0] = t[s[0]];
+      d[1] = t[kHalfValues + s[1]];
+      d[2] = t[2 * kHalfValues + s[2]];
+      d[3] = halfToFloat(a);
+    }
+  }
+
+  // Cells of the contact sheet, row-major from the top left of the region of definition. Each cell
+  // shows the whole source, nearest-neighbour scaled to cellW x cellH.
+  struct WedgeLayout {
+    OfxRectI rod;
+    int cols, rows, cellW, cellH;
   };
-  preset = std::max(0, std::min(19, preset));
-  return mg[preset];
-}
 
-static inline float applyCurve(float x,
-                               float shadowEnd,
-                               float highlightStart,
-                               float pShadow,
-                               float pHighlight) {
-  // Match DCTL behavior: clamp only to >= 0
-  x = std::max(0.0f, x);
+  // Work is split over local cell rows rather than output rows: local row v of every cell comes
+  // from the same source row, which is read once and graded into each cell in the render window.
+  // The rows under the last row of cells (when the height does not divide) are cleared after them.
+  void processWedge(unsigned int maxThreads, int backend) {
+    WedgeLayout g;
+    g.rod = _dst->getRegionOfDefinition();
+    g.cols = (int)std::ceil(std::sqrt((double)_wedgeCount));
+    g.rows = (_wedgeCount + g.cols - 1) / g.cols;
+    g.cellW = (g.rod.x2 - g.rod.x1) / g.cols;
+    g.cellH = (g.rod.y2 - g.rod.y1) / g.rows;
+    if (g.cellW <= 0 || g.cellH <= 0) return;
 
-  // Zone 1: Shadows
-  if (x <= shadowEnd) {
-    if (shadowEnd > 0.0f) {
-      float ratio = x / shadowEnd;
-      ratio = clampf(ratio, 0.0f, 1.0f);
-      return shadowEnd * std::pow(ratio, pShadow);
+    const int items = (g.rod.y2 - g.rod.y1) - g.rows * g.cellH + g.cellH;
+    const unsigned int threads = std::max(1u, maxThreads);
+    const int rows = chunkRows(items, threads);
+    parallelFor(backend, (items + rows - 1) / rows, threads, [&](int chunk) {
+      wedgeRows(g, chunk * rows, std::min(items, (chunk + 1) * rows));
+    }, _host);
+  }
+
+  void wedgeRows(const WedgeLayout& g, int i1, int i2) {
+    const uint64_t workStart = steadyNanos();
+    const ImageView* src = _src;
+    const ImageView* dst = _dst;
+    if (!src || !dst) return;
+
+    const OfxRectI bnd = dst->getBounds();
+    OfxRectI win = _renderWindow;
+    win.x1 = std::max(win.x1, bnd.x1);
+    win.x2 = std::min(win.x2, bnd.x2);
+    win.y1 = std::max(win.y1, bnd.y1);
+    win.y2 = std::min(win.y2, bnd.y2);
+    if (win.x1 >= win.x2 || win.y1 >= win.y2) return;
+
+    const RowKernelFn kernel = selectRowKernel(_p);
+    const OFX::BitDepthEnum srcDepth = src->getPixelDepth();
+    const OFX::BitDepthEnum dstDepth = dst->getPixelDepth();
+    const int dstPixelBytes = 4 * bytesPerComponent(dstDepth);
+    const int width = g.rod.x2 - g.rod.x1;
+    const int height = g.rod.y2 - g.rod.y1;
+    const OfxRectI srcBnd = src->getBounds();
+    const int sx1 = std::max(g.rod.x1, srcBnd.x1), sx2 = std::min(g.rod.x2, srcBnd.x2);
+
+    ScratchArena& arena = ScratchArena::forThisThread();
+    ScratchScope scratchScope(arena);
+    float* line = arena.allocArray<float>((std::size_t)width * 4);     // source row over the RoD
+    float* sampled = arena.allocArray<float>((std::size_t)g.cellW * 4); // the same, scaled to a cell
+    float* graded = arena.allocArray<float>((std::size_t)g.cellW * 4);  // for non-float outputs
+
+    auto clear = [&](int x1, int x2, int y) {
+      x1 = std::max(x1, win.x1);
+      x2 = std::min(x2, win.x2);
+      if (x1 >= x2) return;
+      if (void* d = dst->getPixelAddress(x1, y)) std::memset(d, 0, (std::size_t)(x2 - x1) * dstPixelBytes);
+    };
+
+    uint64_t pixels = 0;
+    uint64_t fastPathPixels = 0;
+    for (int i = i1; i < i2; ++i) {
+      if (i >= g.cellH) { // below the sheet
+        const int y = g.rod.y2 - 1 - (g.rows * g.cellH + (i - g.cellH));
+        if (y >= win.y1 && y < win.y2) clear(g.rod.x1, g.rod.x2, y);
+        continue;
+      }
+
+      bool visible = false;
+      for (int r = 0; r < g.rows; ++r) {
+        const int y = g.rod.y2 - 1 - (r * g.cellH + i);
+        visible = visible || (y >= win.y1 && y < win.y2);
+      }
+      if (!visible) continue;
+
+      // Read the source row once; outside the source image counts as transparent black.
+      const int sy = g.rod.y2 - 1 - (int)((int64_t)i * height / g.cellH);
+      std::memset(line, 0, (std::size_t)width * 4 * sizeof(float));
+      const void* srcRow = sx1 < sx2 ? src->getPixelAddress(sx1, sy) : nullptr;
+      if (srcRow) loadRow(srcDepth, srcRow, line + (std::size_t)(sx1 - g.rod.x1) * 4, sx2 - sx1);
+      for (int u = 0; u < g.cellW; ++u) {
+        const float* s = line + (std::size_t)((int64_t)u * width / g.cellW) * 4;
+        std::memcpy(sampled + (std::size_t)u * 4, s, 4 * sizeof(float));
+      }
+
+      for (int r = 0; r < g.rows; ++r) {
+        const int y = g.rod.y2 - 1 - (r * g.cellH + i);
+        if (y < win.y1 || y >= win.y2) continue;
+        for (int col = 0; col < g.cols; ++col) {
+          const int k = r * g.cols + col;
+          const int cx = g.rod.x1 + col * g.cellW;
+          if (k >= _wedgeCount) {
+            clear(cx, cx + g.cellW, y);
+            continue;
+          }
+          const int x1 = std::max(cx, win.x1), x2 = std::min(cx + g.cellW, win.x2);
+          void* d = x1 < x2 ? dst->getPixelAddress(x1, y) : nullptr;
+          if (!d) continue;
+          const float* in = sampled + (std::size_t)(x1 - cx) * 4;
+          if (dstDepth == OFX::eBitDepthFloat && _dither.mode == kDitherOff) {
+            fastPathPixels += (uint64_t)kernel(in, (float*)d, x2 - x1, _wedge[k]);
+          } else {
+            fastPathPixels += (uint64_t)kernel(in, graded, x2 - x1, _wedge[k]);
+            if (_dither.mode != kDitherOff) {
+              storeRowDithered(_dither, dstDepth, graded, d, x2 - x1, x1, y);
+            } else {
+              storeRow(dstDepth, graded, d, x2 - x1);
+            }
+          }
+          pixels += (uint64_t)(x2 - x1);
+        }
+        clear(g.rod.x1 + g.cols * g.cellW, g.rod.x2, y); // right of the sheet
+      }
     }
-    return x;
+
+    if (_stats) _stats->addPixels(pixels, fastPathPixels);
+    addWork(workStart, pixels);
   }
-  // Zone 2: Preserve mids (linear passthrough)
-  if (x <= highlightStart) {
-    return x;
+
+  // Tiles are the chunks: each is compared, then copied or graded on its own.
+  void processStaticTiles(unsigned int maxThreads, int backend) {
+    const OfxRectI srcBnd = _src ? _src->getBounds() : OfxRectI{0, 0, 0, 0};
+    const OfxRectI dstBnd = _dst->getBounds();
+    OfxRectI area;
+    area.x1 = std::max(_renderWindow.x1, std::max(srcBnd.x1, dstBnd.x1));
+    area.x2 = std::min(_renderWindow.x2, std::min(srcBnd.x2, dstBnd.x2));
+    area.y1 = std::max(_renderWindow.y1, std::max(srcBnd.y1, dstBnd.y1));
+    area.y2 = std::min(_renderWindow.y2, std::min(srcBnd.y2, dstBnd.y2));
+    if (!_src || area.x1 >= area.x2 || area.y1 >= area.y2) return;
+
+    const int tilesX = (area.x2 - area.x1 + kStaticTile - 1) / kStaticTile;
+    const int tilesY = (area.y2 - area.y1 + kStaticTile - 1) / kStaticTile;
+    const std::size_t nTiles = (std::size_t)tilesX * (std::size_t)tilesY;
+    if (_tiles->valid.size() != nTiles) {
+      const std::size_t areaPixels = (std::size_t)(area.x2 - area.x1) * (std::size_t)(area.y2 - area.y1);
+      _tiles->valid.assign(nTiles, 0);
+      _tiles->source.resize(areaPixels * (std::size_t)_src->pixelBytes);
+      _tiles->pixels.resize(areaPixels * (std::size_t)_dst->pixelBytes);
+    }
+
+    std::atomic<int> reused{0};
+    parallelFor(backend, (int)nTiles, std::max(1u, maxThreads), [&](int t) {
+      OfxRectI tile;
+      tile.x1 = area.x1 + (t % tilesX) * kStaticTile;
+      tile.y1 = area.y1 + (t / tilesX) * kStaticTile;
+      tile.x2 = std::min(area.x2, tile.x1 + kStaticTile);
+      tile.y2 = std::min(area.y2, tile.y1 + kStaticTile);
+      if (staticTile(area, tile, _tiles->valid[(std::size_t)t])) {
+        reused.fetch_add(1, std::memory_order_relaxed);
+      }
+    }, _host);
+    if (_stats) _stats->addStaticTiles(nTiles, (uint64_t)reused.load());
   }
-  // Zone 3: Highlights (up to 1.0)
-  if (x <= 1.0f) {
-    float range = 1.0f - highlightStart;
-    if (range > 0.0f) {
-      float ratio = (x - highlightStart) / range;
-      ratio = clampf(ratio, 0.0f, 1.0f);
-      return highlightStart + range * std::pow(ratio, pHighlight);
+
+  // Returns true when the tile was copied from the stored frame rather than graded. A tile with
+  // rows missing from either image is graded but not recorded, so it is never copied back later.
+  bool staticTile(const OfxRectI& area, const OfxRectI& tile, unsigned char& valid) {
+    const std::size_t srcPixelBytes = (std::size_t)_src->pixelBytes;
+    const std::size_t dstPixelBytes = (std::size_t)_dst->pixelBytes;
+    const std::size_t srcRowBytes = (std::size_t)(tile.x2 - tile.x1) * srcPixelBytes;
+    const std::size_t dstRowBytes = (std::size_t)(tile.x2 - tile.x1) * dstPixelBytes;
+    auto stored = [&](std::vector<unsigned char>& buffer, std::size_t pixelBytes, int y) {
+      return buffer.data() + ((std::size_t)(y - area.y1) * (std::size_t)(area.x2 - area.x1) +
+                              (std::size_t)(tile.x1 - area.x1)) * pixelBytes;
+    };
+
+    bool same = valid != 0;
+    for (int y = tile.y1; same && y < tile.y2; ++y) {
+      const void* s = _src->getPixelAddress(tile.x1, y);
+      same = s && std::memcmp(s, stored(_tiles->source, srcPixelBytes, y), srcRowBytes) == 0;
     }
-    return x;
+    if (same) {
+      for (int y = tile.y1; y < tile.y2; ++y) {
+        if (void* d = _dst->getPixelAddress(tile.x1, y)) {
+          std::memcpy(d, stored(_tiles->pixels, dstPixelBytes, y), dstRowBytes);
+        }
+      }
+      return true;
+    }
+
+    processWindow(tile);
+    bool complete = true;
+    for (int y = tile.y1; y < tile.y2; ++y) {
+      const void* s = _src->getPixelAddress(tile.x1, y);
+      const void* d = _dst->getPixelAddress(tile.x1, y);
+      if (s && d) {
+        std::memcpy(stored(_tiles->source, srcPixelBytes, y), s, srcRowBytes);
+        std::memcpy(stored(_tiles->pixels, dstPixelBytes, y), d, dstRowBytes);
+      } else {
+        complete = false;
+      }
+    }
+    valid = complete ? 1 : 0;
+    return false;
   }
-  // Zone 4: Above 1.0
-  return x;
-}
 
-struct ParamsSnapshot {
-  int preset = 9;               // default matches DCTL (DaVinci Intermediate)
-  float preserveMidgray = 0.0f; // 0..1
-  float pShadow[3] = {1,1,1};   // R,G,B
-  float pHighlight[3] = {1,1,1};
-  bool showCurve = false;
-};
+  // Overlay for one worker's band: curves over the diagonal, then the guide lines on top, in the
+  // order the DCTL let them override each other.
+  void drawOverlay(const ImageView& dst, const OfxRectI& clip, const CurveSetup& c) const {
+    const OfxRectI bnd = dst.bounds;
+    OverlayBand band;
+    band.base = dst.data;
+    band.rowBytes = dst.rowBytes;
+    band.bx = bnd.x1;
+    band.by = bnd.y1;
+    drawOverlay(bnd, band, clip, c);
+  }
 
-static inline ParamsSnapshot getParamsAtTime(OFX::ChoiceParam* preset,
-                                             OFX::DoubleParam* preserve,
-                                             OFX::DoubleParam* p1,
-                                             OFX::DoubleParam* p2,
-                                             OFX::DoubleParam* p3,
-                                             OFX::DoubleParam* p4,
-                                             OFX::DoubleParam* p5,
-                                             OFX::DoubleParam* p6,
-                                             OFX::BooleanParam* showCurve,
-                                             double time) {
-  ParamsSnapshot s;
-  preset->getValueAtTime(time, s.preset);
+  // Same, into float pixels addressed by band (base, rowBytes, bx, by) laid out over an image with
+  // bounds bnd; only clip is touched.
+  void drawOverlay(const OfxRectI& bnd, OverlayBand band, const OfxRectI& clip, const CurveSetup& c) const {
+    const int w = bnd.x2 - bnd.x1;
+    const int h = bnd.y2 - bnd.y1;
+    if (w <= 0 || h <= 0) return;
 
-  double v = 0;
-  preserve->getValueAtTime(time, v);
-  s.preserveMidgray = (float)v;
+    band.x1 = std::max(clip.x1, bnd.x1);
+    band.x2 = std::min(clip.x2, bnd.x2);
+    band.y1 = std::max(clip.y1, bnd.y1);
+    band.y2 = std::min(clip.y2, bnd.y2);
+    if (!band.base || band.x1 >= band.x2 || band.y1 >= band.y2) return;
 
-  p1->getValueAtTime(time, v); s.pShadow[0] = (float)v;
-  p2->getValueAtTime(time, v); s.pShadow[1] = (float)v;
-  p3->getValueAtTime(time, v); s.pShadow[2] = (float)v;
+    // Normalized value v sits at x = x1 + v * w and y = y1 + (1 - v) * h.
+    const float fw = (float)w, fh = (float)h;
+    const float lineWidth = 2.5f;             // curve half-width in pixels
+    const float guideWidth = lineWidth * 0.6f;
+    // The DCTL compares normalized x against a height-based width, so vertical guides come out
+    // w/h times wider than horizontal ones; keep that look.
+    const float verticalGuideWidth = guideWidth * fw / fh;
 
-  p4->getValueAtTime(time, v); s.pHighlight[0] = (float)v;
-  p5->getValueAtTime(time, v); s.pHighlight[1] = (float)v;
-  p6->getValueAtTime(time, v); s.pHighlight[2] = (float)v;
+    const float* cols = _curveCols;
+    const int colX0 = _renderWindow.x1 - 1; // column of cols[0]
+    const int colX1 = _renderWindow.x2;     // last column in cols
+    auto yOf = [&](float v) { return (float)bnd.y1 + (1.0f - v) * fh; };
+    auto curveY = [&](int ch) {
+      return [=](int x) { return yOf(cols[3 * (std::min(std::max(x, colX0), colX1) - colX0) + ch]); };
+    };
 
-  bool b = false;
-  showCurve->getValueAtTime(time, b);
-  s.showCurve = b;
+    drawPolyline(band, [&](int x) { return yOf((float)(x - bnd.x1) / fw); }, guideWidth, LightenPaint());
+    drawPolyline(band, curveY(2), lineWidth, SolidPaint{0.3f, 0.5f, 1.0f});
+    drawPolyline(band, curveY(1), lineWidth, SolidPaint{0.0f, 1.0f, 0.0f});
+    drawPolyline(band, curveY(0), lineWidth, SolidPaint{1.0f, 0.0f, 0.0f});
 
-  return s;
+    drawVerticalLine(band, (float)bnd.x1 + c.shadowEnd * fw, verticalGuideWidth, SolidPaint{0.0f, 1.0f, 1.0f});
+    drawVerticalLine(band, (float)bnd.x1 + c.midGray * fw, verticalGuideWidth, SolidPaint{1.0f, 1.0f, 0.0f});
+    drawHorizontalLine(band, yOf(c.midGray), guideWidth, SolidPaint{1.0f, 1.0f, 0.0f});
+    drawVerticalLine(band, (float)bnd.x1 + c.highlightStart * fw, verticalGuideWidth, SolidPaint{1.0f, 0.0f, 1.0f});
+  }
+
+  const ImageView* _src = nullptr;
+  const ImageView* _dst = nullptr;
+  OfxRectI _renderWindow = {0, 0, 0, 0};
+  ParamsSnapshot _p;
+  RenderStats* _stats = nullptr;
+  bool _hwCounters = false;
+  ScratchArena* _scratch = nullptr;
+  RenderHost* _host = nullptr;
+  const float* _curveCols = nullptr; // 3 overlay curve values per render-window column, +1 each side
+  const CurveLut* _lut = nullptr;
+  uint32_t* _lutCoords = nullptr;
+  bool _lutBuild = false;
+  const CurveSetup* _wedge = nullptr;
+  int _wedgeCount = 0;
+  const HalfCurveTable* _halfTable = nullptr;
+  StaticTileFrame* _tiles = nullptr;
+  DitherSetup _dither;
+  uint64_t _dispatchStart = 0;
+  std::atomic<uint64_t> _firstWorkerStart{std::numeric_limits<uint64_t>::max()};
+  std::atomic<uint64_t> _lastWorkerEnd{0};
+  std::atomic<uint64_t> _workNanos{0};
+  std::atomic<uint64_t> _workPixels{0};
+};
+
+// Fan-out sizing: each extra thread must get at least this much work to pay for its dispatch.
+static const double kMinThreadWorkNanos = 50000.0;
+
+// Renders whose per-pixel cost differs get their own estimate: one bit per path that changes it.
+enum CostFlag {
+  kCostFast = 1,
+  kCostDeterministic = 2,
+  kCostBurnIn = 4,
+  kCostHalfTable = 8,
+  kCostLut = 16,
+  kCostWedge = 32,
+  kCostDither = 64,
+  kCostConvert = 128, // loads or stores something other than float
+};
+static const int kCostClasses = 256;
+
+static inline int costClass(const ParamsSnapshot& p, bool halfTable, bool lut, bool wedge, bool dither,
+                            OFX::BitDepthEnum srcDepth, OFX::BitDepthEnum dstDepth) {
+  return (p.kernel == kKernelFast ? kCostFast : 0) | (p.deterministic ? kCostDeterministic : 0) |
+         (p.burnInCurve ? kCostBurnIn : 0) | (halfTable ? kCostHalfTable : 0) | (lut ? kCostLut : 0) |
+         (wedge ? kCostWedge : 0) | (dither ? kCostDither : 0) |
+         (srcDepth != OFX::eBitDepthFloat || dstDepth != OFX::eBitDepthFloat ? kCostConvert : 0);
 }
 
-// Float RGBA processor
-class SplitToneProcessor : public OFX::ImageProcessor {
+// Per-instance renderer
+// Everything a render does once the host has been asked for its images and parameters: picking the
+// cached paths, sizing the fan-out and grading. The effect owns one per instance; tests and tools
+// drive it directly with image views over plain memory and a non-host threading backend.
+struct RenderRequest {
+  uint64_t start = 0; // steadyNanos() when the render action began
+  double time = 0.0;
+  OfxRectI window = {0, 0, 0, 0};
+  bool interactive = false;
+  ParamsSnapshot params;
+  WedgeSetup wedge;
+  DitherSetup dither;
+  int threading = kThreadingHost;
+  unsigned int cpus = 1;
+  bool fastSliderPreview = false;
+  bool reuseStaticTiles = false;
+  bool hwCounters = false;
+  // Asked once grading is done: an aborted render may be incomplete, so it updates no cache.
+  bool (*aborted)(const void* context) = nullptr;
+  const void* abortContext = nullptr;
+  RenderHost* host = nullptr; // provides the host threading backend; null for the OFX suite
+};
+
+class SplitToneRenderer {
 public:
-  SplitToneProcessor(OFX::ImageEffect &instance)
-  : OFX::ImageProcessor(instance) {}
+  SplitToneRenderer() {
+    for (int i = 0; i < kCostClasses; ++i) _nanosPerPixel[i].store(0.0, std::memory_order_relaxed);
+  }
+  SplitToneRenderer(const SplitToneRenderer&) = delete;
+  SplitToneRenderer& operator=(const SplitToneRenderer&) = delete;
+  ~SplitToneRenderer() { StaticTileStore::instance().forget(this); }
 
-  void setSrcImg(const OFX::Image *src) { _src = src; }
-  void setParams(const ParamsSnapshot& p) { _p = p; }
+  RenderStats& stats() { return _stats; }
 
-  void multiThreadProcessImages(OfxRectI procWindow) override {
-    const OFX::Image* src = _src;
-    OFX::Image* dst = _dstImg;
-    if (!src || !dst) return;
+  void render(const ImageView& src, const ImageView& dst, const RenderRequest& req) {
+    ParamsSnapshot p = req.params;
+    const WedgeSetup& wedge = req.wedge;
+    const DitherSetup& dither = req.dither;
+    const int threading = req.threading;
+    if (wedge.count) p.burnInCurve = false; // the curve layout does not fit a contact sheet
 
-    const int w = dst->getBounds().x2 - dst->getBounds().x1;
-    const int h = dst->getBounds().y2 - dst->getBounds().y1;
-
-    // Compute boundaries (same as DCTL)
-    const float midGray = getMiddleGray(_p.preset);
-    const float gapDist = midGray * _p.preserveMidgray;
-    float shadowEnd = std::max(0.0f, midGray - gapDist);
-    float highlightStart = std::min(1.0f, midGray + gapDist);
-
-    for (int y = procWindow.y1; y < procWindow.y2; ++y) {
-      for (int x = procWindow.x1; x < procWindow.x2; ++x) {
-        const float* srcPix = (const float*)src->getPixelAddress(x, y);
-        float* dstPix = (float*)dst->getPixelAddress(x, y);
-        if (!srcPix || !dstPix) continue;
-
-        float r = srcPix[0];
-        float g = srcPix[1];
-        float b = srcPix[2];
-        float a = srcPix[3];
-
-        float rOut = applyCurve(r, shadowEnd, highlightStart, _p.pShadow[0], _p.pHighlight[0]);
-        float gOut = applyCurve(g, shadowEnd, highlightStart, _p.pShadow[1], _p.pHighlight[1]);
-        float bOut = applyCurve(b, shadowEnd, highlightStart, _p.pShadow[2], _p.pHighlight[2]);
-
-        if (_p.showCurve && w > 0 && h > 0) {
-          // DCTL: x_norm = X/Width; y_norm = 1 - Y/Height
-          // In OFX, image bounds may not start at (0,0), so normalize relative to bounds.
-          const OfxRectI bnd = dst->getBounds();
-          const float xNorm = (float)(x - bnd.x1) / (float)w;
-          const float yNorm = 1.0f - ((float)(y - bnd.y1) / (float)h);
-
-          const float curveR = applyCurve(xNorm, shadowEnd, highlightStart, _p.pShadow[0], _p.pHighlight[0]);
-          const float curveG = applyCurve(xNorm, shadowEnd, highlightStart, _p.pShadow[1], _p.pHighlight[1]);
-          const float curveB = applyCurve(xNorm, shadowEnd, highlightStart, _p.pShadow[2], _p.pHighlight[2]);
-
-          const float lineThickness = 2.5f / (float)h;
-
-          // RGB curves
-          if (std::fabs(yNorm - curveR) < lineThickness) {
-            rOut = 1.0f; gOut = 0.0f; bOut = 0.0f;
-          } else if (std::fabs(yNorm - curveG) < lineThickness) {
-            rOut = 0.0f; gOut = 1.0f; bOut = 0.0f;
-          } else if (std::fabs(yNorm - curveB) < lineThickness) {
-            rOut = 0.3f; gOut = 0.5f; bOut = 1.0f;
-          } else if (std::fabs(yNorm - xNorm) < lineThickness * 0.6f) {
-            // Diagonal reference line
-            rOut = rOut * 0.4f + 0.6f;
-            gOut = gOut * 0.4f + 0.6f;
-            bOut = bOut * 0.4f + 0.6f;
-          }
+    SplitToneProcessor proc;
+    proc.setImages(&src, &dst);
+    proc.setParams(p);
+    proc.setStats(&_stats);
+    proc.setHardwareCounters(req.hwCounters);
+    proc.setDither(dither);
+    proc.setHost(req.host);
 
-          // Shadow end line (cyan)
-          if (std::fabs(xNorm - shadowEnd) < lineThickness * 0.6f) {
-            rOut = 0.0f; gOut = 1.0f; bOut = 1.0f;
-          }
+    ScratchArena& scratch = ScratchArena::forThisThread();
+    ScratchScope scratchScope(scratch);
+    proc.setScratch(&scratch);
+    const uint64_t blocksBefore = ScratchArena::blocksAllocated();
 
-          // Middle gray line (yellow) — both vertical and horizontal
-          if (std::fabs(xNorm - midGray) < lineThickness * 0.6f ||
-              std::fabs(yNorm - midGray) < lineThickness * 0.6f) {
-            rOut = 1.0f; gOut = 1.0f; bOut = 0.0f;
-          }
+    // Half sources are graded through exact tables.
+    const bool halfSource = src.depth == OFX::eBitDepthHalf && !wedge.count;
+    std::shared_ptr<const HalfCurveTable> halfTable;
+    if (halfSource) {
+      const bool halfOut = dst.depth == OFX::eBitDepthHalf && !p.burnInCurve && dither.mode == kDitherOff;
+      halfTable = BakedCurveStore::instance().get(p, halfOut, threading, req.cpus, req.host);
+      proc.setHalfTable(halfTable.get());
+    }
 
-          // Highlight start line (magenta)
-          if (std::fabs(xNorm - highlightStart) < lineThickness * 0.6f) {
-            rOut = 1.0f; gOut = 0.0f; bOut = 1.0f;
-          }
+    // Other interactive Reference renders of a frame seen before go through the paused-frame LUT,
+    // unless its coordinates alone would not fit the store's budget.
+    std::shared_ptr<const LutFrame> lutFrame;
+    std::shared_ptr<LutFrame> lutBuild;
+    CurveLut lut;
+    const uint64_t windowPixels = (uint64_t)std::max(0, req.window.x2 - req.window.x1) *
+                                  (uint64_t)std::max(0, req.window.y2 - req.window.y1);
+    if (req.fastSliderPreview && req.interactive && !p.deterministic && p.kernel == kKernelReference &&
+        !wedge.count && !halfSource && windowPixels * 3 * sizeof(uint32_t) <= LutFrameStore::kMaxBytes) {
+      LutFrameKey key;
+      key.time = req.time;
+      key.window = req.window;
+      key.preset = p.preset;
+      key.preserveMidgray = p.preserveMidgray;
+      lutFrame = _lutFrames.lookup(key);
+      if (lutFrame) {
+        const uint64_t sourceHash = hashSourceWindow(src, req.window);
+        if (lutFrame->coords.empty() || lutFrame->sourceHash != sourceHash) {
+          const OfxRectI& rw = req.window;
+          lutBuild = std::make_shared<LutFrame>();
+          lutBuild->key = key;
+          lutBuild->sourceHash = sourceHash;
+          lutBuild->coords.resize((std::size_t)(rw.x2 - rw.x1) * (std::size_t)(rw.y2 - rw.y1) * 3);
+          lutFrame = lutBuild;
         }
-
-        dstPix[0] = rOut;
-        dstPix[1] = gOut;
-        dstPix[2] = bOut;
-        dstPix[3] = a;
+        lut = makeCurveLut(scratch.allocArray<float>(kCurveLutFloats), makeCurveSetup(p));
+        proc.setLut(&lut, const_cast<uint32_t*>(lutFrame->coords.data()), lutBuild != nullptr);
       }
     }
+
+    // Tiles graded through the LUT would not match a full grade, so those renders do not take part;
+    // nor do windows whose stored source and output alone would not fit the store's budget.
+    std::unique_ptr<StaticTileFrame> tiles;
+    if (req.reuseStaticTiles && !wedge.count && !lutFrame &&
+        windowPixels * (uint64_t)(src.pixelBytes + dst.pixelBytes) <= StaticTileStore::kMaxBytes) {
+      StaticTileKey key;
+      key.owner = this;
+      key.window = req.window;
+      key.srcBounds = src.bounds;
+      key.dstBounds = dst.bounds;
+      key.srcDepth = src.depth;
+      key.dstDepth = dst.depth;
+      StaticTileGrade grade;
+      grade.params = p;
+      grade.ditherMode = dither.mode;
+      grade.ditherBits = dither.bits;
+      tiles = StaticTileStore::instance().checkOut(key, grade);
+      proc.setStaticTiles(tiles.get());
+    }
+
+    if (wedge.count) {
+      CurveSetup* variants = scratch.allocArray<CurveSetup>((std::size_t)wedge.count);
+      for (int k = 0; k < wedge.count; ++k) variants[k] = makeWedgeVariant(p, wedge, k);
+      proc.setWedge(variants, wedge.count);
+    }
+
+    proc.setRenderWindow(req.window);
+    const int cost = costClass(p, halfSource, lutFrame != nullptr, wedge.count > 0, dither.mode != kDitherOff,
+                               src.depth, dst.depth);
+    const unsigned int threads = fanOut(cost, req.window, req.cpus);
+    const uint64_t kernelStart = steadyNanos();
+    proc.process(threads, threading);
+    const uint64_t end = steadyNanos();
+    const bool aborted = req.aborted && req.aborted(req.abortContext);
+    _stats.addFanOut(threads);
+    // Reused static tiles cost a copy, not a grade, so those renders would drag the estimate down.
+    if (!tiles) updateCostEstimate(cost, proc.workNanosPerPixel());
+    _stats.addHostCalls(kActionRender, kHostDispatch, 1, proc.dispatchNanos(end));
+    if (lutFrame) {
+      // An aborted render may have left coordinates unwritten.
+      if (lutBuild && !aborted) _lutFrames.publish(lutBuild);
+      _stats.addLutRender(lutBuild != nullptr);
+    }
+    if (tiles && !aborted) StaticTileStore::instance().checkIn(std::move(tiles));
+
+    // Counted across all threads, so concurrent renders of other instances can inflate it.
+    _stats.addScratchAllocations(ScratchArena::blocksAllocated() - blocksBefore);
+
+    const uint64_t kernelNanos = end - kernelStart;
+    _stats.addRender(end - (req.start ? req.start : kernelStart), kernelNanos,
+                     windowPixels * (uint64_t)(src.pixelBytes + dst.pixelBytes));
   }
 
 private:
-  const OFX::Image* _src = nullptr;
-  ParamsSnapshot _p;
+  // Threads for a render window: as many as keep every thread busy for kMinThreadWorkNanos at the
+  // measured cost of its cost class. Until a cost is known, all CPUs are used.
+  unsigned int fanOut(int cost, const OfxRectI& rw, unsigned int cpus) const {
+    cpus = std::max(1u, cpus);
+    const double nanosPerPixel = _nanosPerPixel[cost].load(std::memory_order_relaxed);
+    if (nanosPerPixel <= 0.0) return cpus;
+    const double pixels = (double)std::max(0, rw.x2 - rw.x1) * (double)std::max(0, rw.y2 - rw.y1);
+    const double threads = std::floor(pixels * nanosPerPixel / kMinThreadWorkNanos);
+    return (unsigned int)std::max(1.0, std::min((double)cpus, threads));
+  }
+
+  // Exponential moving average, so the estimate follows machine load without jumping on outliers.
+  void updateCostEstimate(int cost, double nanosPerPixel) {
+    if (nanosPerPixel <= 0.0) return;
+    std::atomic<double>& est = _nanosPerPixel[cost];
+    double old = est.load(std::memory_order_relaxed);
+    double next;
+    do {
+      next = old > 0.0 ? 0.8 * old + 0.2 * nanosPerPixel : nanosPerPixel;
+    } while (!est.compare_exchange_weak(old, next, std::memory_order_relaxed));
+  }
+
+  RenderStats _stats;
+  std::atomic<double> _nanosPerPixel[kCostClasses]; // measured worker cost per cost class
+  LutFrameCache _lutFrames;
 };
 
+// The render action on any host: images and params come from host, each call timed and booked under
+// kActionRender (the threading backend's share is booked by the renderer), then the window is graded.
+static void renderAction(SplitToneRenderer& renderer, RenderHost& host, double time, const OfxRectI& window,
+                         bool interactive) {
+  const uint64_t start = steadyNanos();
+  RenderStats& stats = renderer.stats();
+  ImageView src, dst;
+  host.fetchImages(time, src, dst);
+  stats.addHostCalls(kActionRender, kHostFetchImage, 2, steadyNanos() - start);
+
+  const uint64_t paramsStart = steadyNanos();
+  RenderRequest req;
+  host.fetchRenderParams(time, req);
+  stats.addHostCalls(kActionRender, kHostGetParams, 1, steadyNanos() - paramsStart);
+
+  req.start = start;
+  req.time = time;
+  req.window = window;
+  req.interactive = interactive;
+  req.aborted = [](const void* h) { return static_cast<const RenderHost*>(h)->aborted(); };
+  req.abortContext = &host;
+  req.host = &host;
+  renderer.render(src, dst, req);
+}
+
+// The isIdentity action on any host: true when the grade leaves every pixel as it is.
+static bool isIdentityAction(SplitToneRenderer& renderer, RenderHost& host, double time) {
+  const uint64_t paramsStart = steadyNanos();
+  ParamsSnapshot p;
+  int ditherMode = kDitherOff;
+  WedgeSetup wedge;
+  host.fetchIdentityParams(time, p, ditherMode, wedge);
+  renderer.stats().addHostCalls(kActionIsIdentity, kHostGetParams, 1, steadyNanos() - paramsStart);
+
+  const bool curveOff = !p.burnInCurve && ditherMode == kDitherOff && !wedge.count;
+  const bool preserveOff = std::fabs(p.preserveMidgray) < 1e-8f;
+  const bool allOnes =
+    std::fabs(p.pShadow[0] - 1.0f) < 1e-8f &&
+    std::fabs(p.pShadow[1] - 1.0f) < 1e-8f &&
+    std::fabs(p.pShadow[2] - 1.0f) < 1e-8f &&
+    std::fabs(p.pHighlight[0] - 1.0f) < 1e-8f &&
+    std::fabs(p.pHighlight[1] - 1.0f) < 1e-8f &&
+    std::fabs(p.pHighlight[2] - 1.0f) < 1e-8f;
+  if (!(curveOff && preserveOff && allOnes)) return false;
+  renderer.stats().addIdentity();
+  return true;
+}
+
 class SplitToneEffect : public OFX::ImageEffect {
 public:
   SplitToneEffect(OfxImageEffectHandle handle)
@@ -235,55 +3811,159 @@ public:
   , _p5(fetchDoubleParam("highlightG"))
   , _p6(fetchDoubleParam("highlightB"))
   , _showCurve(fetchBooleanParam("showCurve"))
-  {}
+  , _burnInCurve(fetchBooleanParam("burnInCurve"))
+  , _deterministic(fetchBooleanParam("deterministic"))
+  , _kernel(fetchChoiceParam("kernel"))
+  , _fastSliderPreview(fetchBooleanParam("fastSliderPreview"))
+  , _reuseStaticTiles(fetchBooleanParam("reuseStaticTiles"))
+  , _dither(fetchChoiceParam("outputDither"))
+  , _ditherBits(fetchChoiceParam("ditherBits"))
+  , _threading(fetchChoiceParam("threading"))
+  , _wedgeEnabled(fetchBooleanParam("wedge"))
+  , _wedgeCount(fetchIntParam("wedgeCount"))
+  , _wedgeTarget(fetchChoiceParam("wedgeTarget"))
+  , _wedgeSpread(fetchDoubleParam("wedgeSpread"))
+  , _perfReportFile(fetchStringParam("perfReportFile"))
+  , _hwCounters(fetchBooleanParam("hardwareCounters"))
+  , _paramsVersion(fetchIntParam("paramsVersion"))
+  {
+    upgradeParams();
+  }
 
   void render(const OFX::RenderArguments &args) override {
-    std::unique_ptr<OFX::Image> dst(_dstClip->fetchImage(args.time));
-    std::unique_ptr<const OFX::Image> src(_srcClip->fetchImage(args.time));
+    ActionHost host(*this);
+    renderAction(_renderer, host, args.time, args.renderWindow, args.interactiveRenderStatus);
+  }
 
-    if (!dst || !src) {
-      OFX::throwSuiteStatusException(kOfxStatFailed);
-    }
+  bool isIdentity(const OFX::IsIdentityArguments &args, OFX::Clip * &identityClip, double &identityTime) override {
+    ActionHost host(*this);
+    if (!isIdentityAction(_renderer, host, args.time)) return false;
+    identityClip = _srcClip;
+    identityTime = args.time;
+    return true;
+  }
+
+  // A contact sheet samples the whole source for any part of the output.
+  void getRegionsOfInterest(const OFX::RegionsOfInterestArguments& args, OFX::RegionOfInterestSetter& rois) override {
+    bool wedge = false;
+    _wedgeEnabled->getValueAtTime(args.time, wedge);
+    if (wedge) rois.setRegionOfInterest(*_srcClip, _srcClip->getRegionOfDefinition(args.time));
+  }
+
+  // Take the source at its own depth rather than have the host convert it to the output's; the
+  // render converts while grading. The output keeps the depth the host picked for it.
+  // Hosts ask for clip preferences before the first render, which is where an instance with nothing
+  // to upgrade gets its paramsVersion.
+  void getClipPreferences(OFX::ClipPreferencesSetter& clipPreferences) override {
+    stampParamsVersion(*_paramsVersion);
+    if (!OFX::getImageEffectHostDescription()->supportsMultipleClipDepths) return;
+    const OFX::BitDepthEnum depth = _srcClip->getUnmappedBitDepth();
+    if (isSupportedDepth(depth)) clipPreferences.setClipBitDepth(*_srcClip, depth);
+  }
+
+  // What the viewer overlay draws at a time: false when Show Curve is off.
+  bool overlayAt(double time, CurveSetup& curve, OfxRectD& rod) {
+    bool show = false;
+    _showCurve->getValueAtTime(time, show);
+    if (!show) return false;
+    curve = makeCurveSetup(getParamsAtTime(_preset, _preserve, _p1, _p2, _p3, _p4, _p5, _p6, _burnInCurve,
+                                           _deterministic, _kernel, time));
+    rod = _srcClip->getRegionOfDefinition(time);
+    return rod.x2 > rod.x1 && rod.y2 > rod.y1;
+  }
 
-    // Expect float RGBA
-    if (dst->getPixelDepth() != OFX::eBitDepthFloat || src->getPixelDepth() != OFX::eBitDepthFloat ||
-        dst->getPixelComponents() != OFX::ePixelComponentRGBA || src->getPixelComponents() != OFX::ePixelComponentRGBA) {
-      OFX::throwSuiteStatusException(kOfxStatErrUnsupported);
+  void changedParam(const OFX::InstanceChangedArgs& /*args*/, const std::string& paramName) override {
+    if (paramName == "showCurve") {
+      stampParamsVersion(*_paramsVersion); // from now on Show Curve only means the viewer overlay
+      redrawOverlays();
+      return;
     }
+    if (paramName != "reportPerformance") return;
 
-    ParamsSnapshot p = getParamsAtTime(_preset, _preserve, _p1, _p2, _p3, _p4, _p5, _p6, _showCurve, args.time);
+    const StatsTotals t = _renderer.stats().totals();
 
-    SplitToneProcessor proc(*this);
-    proc.setDstImg(dst.get());
-    proc.setSrcImg(src.get());
-    proc.setParams(p);
+    bool hwCounters = false;
+    _hwCounters->getValue(hwCounters);
+    std::string msg = formatStatsSummary(t, hwCounters);
+
+    std::string path;
+    _perfReportFile->getValue(path);
+    if (!path.empty()) {
+      std::ofstream out(path.c_str(), std::ios::out | std::ios::trunc);
+      out << formatStatsJson(t);
+      msg += out ? "JSON written to " + path + "\n" : "Could not write " + path + "\n";
+    }
 
-    proc.setRenderWindow(args.renderWindow);
-    proc.process();
+    sendMessage(OFX::Message::eMessageMessage, "", msg);
   }
 
-  bool isIdentity(const OFX::IsIdentityArguments &args, OFX::Clip * &identityClip, double &identityTime) override {
-    ParamsSnapshot p = getParamsAtTime(_preset, _preserve, _p1, _p2, _p3, _p4, _p5, _p6, _showCurve, args.time);
-
-    const bool curveOff = !p.showCurve;
-    const bool preserveOff = std::fabs(p.preserveMidgray) < 1e-8f;
-    const bool allOnes =
-      std::fabs(p.pShadow[0] - 1.0f) < 1e-8f &&
-      std::fabs(p.pShadow[1] - 1.0f) < 1e-8f &&
-      std::fabs(p.pShadow[2] - 1.0f) < 1e-8f &&
-      std::fabs(p.pHighlight[0] - 1.0f) < 1e-8f &&
-      std::fabs(p.pHighlight[1] - 1.0f) < 1e-8f &&
-      std::fabs(p.pHighlight[2] - 1.0f) < 1e-8f;
-
-    if (curveOff && preserveOff && allOnes) {
-      identityClip = _srcClip;
-      identityTime = args.time;
-      return true;
+private:
+  // The OFX suites as a RenderHost for one action, holding the images it fetched.
+  class ActionHost : public RenderHost {
+  public:
+    explicit ActionHost(SplitToneEffect& effect) : _effect(effect) {}
+
+    void fetchImages(double time, ImageView& src, ImageView& dst) override {
+      _dst.reset(_effect._dstClip->fetchImage(time));
+      _src.reset(_effect._srcClip->fetchImage(time));
+      if (!_dst || !_src) {
+        OFX::throwSuiteStatusException(kOfxStatFailed);
+      }
+
+      // Expect RGBA, each clip at any supported depth
+      if (!isSupportedDepth(_dst->getPixelDepth()) || !isSupportedDepth(_src->getPixelDepth()) ||
+          _dst->getPixelComponents() != OFX::ePixelComponentRGBA ||
+          _src->getPixelComponents() != OFX::ePixelComponentRGBA) {
+        OFX::throwSuiteStatusException(kOfxStatErrUnsupported);
+      }
+
+      // The views read what the support library cached when fetchImage built each image.
+      src = ImageView::of(*_src);
+      dst = ImageView::of(*_dst);
     }
-    return false;
+
+    void fetchRenderParams(double time, RenderRequest& req) override {
+      SplitToneEffect& e = _effect;
+      req.params = getParamsAtTime(e._preset, e._preserve, e._p1, e._p2, e._p3, e._p4, e._p5, e._p6,
+                                   e._burnInCurve, e._deterministic, e._kernel, time);
+      e._hwCounters->getValue(req.hwCounters);
+      e._fastSliderPreview->getValue(req.fastSliderPreview);
+      e._reuseStaticTiles->getValue(req.reuseStaticTiles);
+      e._threading->getValue(req.threading);
+      req.wedge = getWedgeAtTime(e._wedgeEnabled, e._wedgeCount, e._wedgeTarget, e._wedgeSpread, time);
+      req.dither = getDitherAtTime(e._dither, e._ditherBits, time);
+      req.cpus = std::max(1u, OFX::MultiThread::getNumCPUs());
+    }
+
+    void fetchIdentityParams(double time, ParamsSnapshot& p, int& ditherMode, WedgeSetup& wedge) override {
+      SplitToneEffect& e = _effect;
+      p = getParamsAtTime(e._preset, e._preserve, e._p1, e._p2, e._p3, e._p4, e._p5, e._p6, e._burnInCurve,
+                          e._deterministic, e._kernel, time);
+      e._dither->getValueAtTime(time, ditherMode);
+      wedge = getWedgeAtTime(e._wedgeEnabled, e._wedgeCount, e._wedgeTarget, e._wedgeSpread, time);
+    }
+
+    void multiThread(int nChunks, unsigned int maxThreads, const ChunkFn& fn) override {
+      hostMultiThread(nChunks, maxThreads, fn);
+    }
+
+    bool aborted() const override { return _effect.abort(); }
+
+  private:
+    SplitToneEffect& _effect;
+    std::unique_ptr<OFX::Image> _dst;
+    std::unique_ptr<const OFX::Image> _src;
+  };
+
+  // Instances saved before 1.1 have no paramsVersion, so they read its default of 0. When their
+  // values mean something else now (see paramsNeedUpgrade) they are carried over and stamped, as one
+  // undoable edit, while the instance is created and before any render or instance-changed action
+  // could see them. Everything else, new instances included, is only stamped, by
+  // stampParamsVersion outside any edit block, so creating an instance leaves no undo step.
+  void upgradeParams() {
+    upgradeParamsOnCreate(*this, *_paramsVersion, *_showCurve, *_burnInCurve);
   }
 
-private:
   OFX::Clip *_srcClip = nullptr;
   OFX::Clip *_dstClip = nullptr;
 
@@ -298,19 +3978,120 @@ private:
   OFX::DoubleParam* _p6 = nullptr;
 
   OFX::BooleanParam* _showCurve = nullptr;
+  OFX::BooleanParam* _burnInCurve = nullptr;
+  OFX::BooleanParam* _deterministic = nullptr;
+  OFX::ChoiceParam* _kernel = nullptr;
+  OFX::BooleanParam* _fastSliderPreview = nullptr;
+  OFX::BooleanParam* _reuseStaticTiles = nullptr;
+  OFX::ChoiceParam* _dither = nullptr;
+  OFX::ChoiceParam* _ditherBits = nullptr;
+  OFX::ChoiceParam* _threading = nullptr;
+
+  OFX::BooleanParam* _wedgeEnabled = nullptr;
+  OFX::IntParam* _wedgeCount = nullptr;
+  OFX::ChoiceParam* _wedgeTarget = nullptr;
+  OFX::DoubleParam* _wedgeSpread = nullptr;
+
+  OFX::StringParam* _perfReportFile = nullptr;
+  OFX::BooleanParam* _hwCounters = nullptr;
+  OFX::IntParam* _paramsVersion = nullptr;
+
+  SplitToneRenderer _renderer;
+};
+
+#ifndef SPLITTONE_NO_OVERLAY
+// Viewer overlay
+// Draws the curves and zone lines in the host viewer, in canonical coordinates over the source's
+// region of definition and in the same layout as the burned-in overlay. Nothing here touches the
+// render, so toggling it neither re-renders nor invalidates cached frames.
+class SplitToneOverlay : public OFX::OverlayInteract {
+public:
+  SplitToneOverlay(OfxInteractHandle handle, OFX::ImageEffect* effect)
+  : OFX::OverlayInteract(handle)
+  , _plugin(dynamic_cast<SplitToneEffect*>(effect))
+  {}
+
+  bool draw(const OFX::DrawArgs& args) override {
+    CurveSetup c;
+    OfxRectD rod;
+    if (!_plugin || !_plugin->overlayAt(args.time, c, rod)) return false;
+
+    const double w = rod.x2 - rod.x1;
+    const double h = rod.y2 - rod.y1;
+    auto vx = [&](double v) { return rod.x1 + v * w; };
+    auto vy = [&](double v) { return rod.y1 + (1.0 - v) * h; };
+    // About one vertex per two screen pixels across the frame.
+    const double screenWidth = w / std::max(args.pixelScale.x, 1e-6);
+    const int segments = (int)std::min(4096.0, std::max(64.0, screenWidth * 0.5));
+
+    glPushAttrib(GL_ENABLE_BIT | GL_LINE_BIT | GL_CURRENT_BIT | GL_COLOR_BUFFER_BIT);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_LINE_SMOOTH);
+
+    glLineWidth(1.5f);
+    glColor4f(1.0f, 1.0f, 1.0f, 0.6f);
+    glBegin(GL_LINES);
+    glVertex2d(vx(0.0), vy(0.0));
+    glVertex2d(vx(1.0), vy(1.0));
+    glEnd();
+
+    static const float kCurveColours[3][3] = { {1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.3f, 0.5f, 1.0f} };
+    glLineWidth(2.5f);
+    for (int ch = 2; ch >= 0; --ch) {
+      glColor3fv(kCurveColours[ch]);
+      glBegin(GL_LINE_STRIP);
+      for (int i = 0; i <= segments; ++i) {
+        const float v = (float)i / (float)segments;
+        glVertex2d(vx(v), vy(applyCurve(v, c.shadowEnd, c.highlightStart, c.pShadow[ch], c.pHighlight[ch])));
+      }
+      glEnd();
+    }
+
+    glLineWidth(1.5f);
+    glBegin(GL_LINES);
+    glColor3f(0.0f, 1.0f, 1.0f);
+    glVertex2d(vx(c.shadowEnd), rod.y1);
+    glVertex2d(vx(c.shadowEnd), rod.y2);
+    glColor3f(1.0f, 1.0f, 0.0f);
+    glVertex2d(vx(c.midGray), rod.y1);
+    glVertex2d(vx(c.midGray), rod.y2);
+    glVertex2d(rod.x1, vy(c.midGray));
+    glVertex2d(rod.x2, vy(c.midGray));
+    glColor3f(1.0f, 0.0f, 1.0f);
+    glVertex2d(vx(c.highlightStart), rod.y1);
+    glVertex2d(vx(c.highlightStart), rod.y2);
+    glEnd();
+
+    glPopAttrib();
+    return true;
+  }
+
+private:
+  SplitToneEffect* _plugin = nullptr;
 };
 
+class SplitToneOverlayDescriptor
+: public OFX::DefaultEffectOverlayDescriptor<SplitToneOverlayDescriptor, SplitToneOverlay> {};
+#endif
+
 class SplitTonePluginFactory : public OFX::PluginFactoryHelper<SplitTonePluginFactory> {
 public:
   SplitTonePluginFactory()
   : OFX::PluginFactoryHelper<SplitTonePluginFactory>(kPluginIdentifier, kPluginVersionMajor, kPluginVersionMinor)
   {}
 
+  // The pool's threads are joined here rather than in a static destructor (see WorkStealingPool).
+  void unload() override { WorkStealingPool::instance().shutdown(); }
+
   void describe(OFX::ImageEffectDescriptor &desc) override {
     desc.setLabels(kPluginName, kPluginName, kPluginName);
     desc.setPluginGrouping(kPluginGrouping);
 
     desc.addSupportedContext(OFX::eContextFilter);
+    desc.addSupportedBitDepth(OFX::eBitDepthUByte);
+    desc.addSupportedBitDepth(OFX::eBitDepthUShort);
+    desc.addSupportedBitDepth(OFX::eBitDepthHalf);
     desc.addSupportedBitDepth(OFX::eBitDepthFloat);
 
     desc.setSingleInstance(false);
@@ -319,7 +4100,11 @@ public:
     desc.setSupportsTiles(true);
     desc.setRenderTwiceAlways(false);
     desc.setSupportsMultipleClipPARs(false);
-    desc.setSupportsMultipleClipDepths(false);
+    desc.setSupportsMultipleClipDepths(true);
+
+#ifndef SPLITTONE_NO_OVERLAY
+    desc.setOverlayInteractDescriptor(new SplitToneOverlayDescriptor);
+#endif
   }
 
   void describeInContext(OFX::ImageEffectDescriptor &desc, OFX::ContextEnum /*context*/) override {
@@ -379,11 +4164,190 @@ public:
     page->addChild(*makeSlider("highlightG","Highlight Green",1.0));
     page->addChild(*makeSlider("highlightB","Highlight Blue",1.0));
 
-    // Show curve
+    // Show curve (viewer overlay only)
     OFX::BooleanParamDescriptor* showCurve = desc.defineBooleanParam("showCurve");
     showCurve->setLabel("Show Curve");
+    showCurve->setHint("Draws the curves and zone lines over the image in the viewer. Rendered frames are not affected.");
     showCurve->setDefault(false);
+    showCurve->setEvaluateOnChange(false);
+#ifdef SPLITTONE_NO_OVERLAY
+    showCurve->setIsSecret(true); // kept so saved values survive, and for upgradeParams
+#endif
     page->addChild(*showCurve);
+
+    // Burn in curve
+    OFX::BooleanParamDescriptor* burnInCurve = desc.defineBooleanParam("burnInCurve");
+    burnInCurve->setLabel("Burn In Curve");
+    burnInCurve->setHint("Draws the curve overlay into the rendered image, for hosts without viewer overlays "
+                         "or to export it.");
+    burnInCurve->setDefault(false);
+    burnInCurve->setAnimates(true); // takes the keys of an animated Show Curve from before 1.1
+    page->addChild(*burnInCurve);
+
+    // Deterministic output
+    OFX::BooleanParamDescriptor* deterministic = desc.defineBooleanParam("deterministic");
+    deterministic->setLabel("Deterministic");
+    deterministic->setHint("Uses a portable curve evaluation that produces bit-identical output on every "
+                           "machine, SIMD width, tile size and thread count (for checksum-based QC).");
+    deterministic->setDefault(false);
+    page->addChild(*deterministic);
+
+    // Kernel
+    OFX::ChoiceParamDescriptor* kernel = desc.defineChoiceParam("kernel");
+    kernel->setLabel("Kernel");
+    kernel->setHint("Reference evaluates the curve exactly as the DCTL. Fast uses SIMD kernels "
+                    "(AVX2/AVX-512 when available) with under 1e-6 absolute error.");
+    kernel->appendOption("Reference");
+    kernel->appendOption("Fast");
+    kernel->setDefault(kKernelReference);
+    page->addChild(*kernel);
+
+    // Fast slider preview
+    OFX::BooleanParamDescriptor* fastSliderPreview = desc.defineBooleanParam("fastSliderPreview");
+    fastSliderPreview->setLabel("Fast Slider Preview");
+    fastSliderPreview->setHint("While adjusting a paused frame in the viewer, grades through cached per-pixel "
+                               "lookup coordinates (under 5e-6 relative error), kept in up to 128 MB shared "
+                               "by all instances. Final renders and Deterministic mode are never affected.");
+    fastSliderPreview->setDefault(false);
+    fastSliderPreview->setAnimates(false);
+    page->addChild(*fastSliderPreview);
+
+    OFX::BooleanParamDescriptor* reuseStaticTiles = desc.defineBooleanParam("reuseStaticTiles");
+    reuseStaticTiles->setLabel("Reuse Static Tiles");
+    reuseStaticTiles->setHint("For locked-off shots: keeps the last graded frame and copies each 64x64 tile "
+                              "whose source pixels and grade are unchanged instead of grading it again. "
+                              "Output is identical; costs a comparison of every source tile and the "
+                              "previous frame's source and output per render window, in up to 256 MB "
+                              "shared by all instances.");
+    reuseStaticTiles->setDefault(false);
+    reuseStaticTiles->setAnimates(false);
+    page->addChild(*reuseStaticTiles);
+
+    // Output dither
+    OFX::GroupParamDescriptor* ditherGroup = desc.defineGroupParam("ditherGroup");
+    ditherGroup->setLabel("Output Dither");
+    ditherGroup->setOpen(false);
+    page->addChild(*ditherGroup);
+
+    OFX::ChoiceParamDescriptor* outputDither = desc.defineChoiceParam("outputDither");
+    outputDither->setLabel("Dither");
+    outputDither->setHint("Quantizes color to the target levels while writing the output, with a tiled "
+                          "threshold pattern that turns banding into fine noise. Replaces a separate "
+                          "quantize/dither pass for 8- and 10-bit review media. Alpha is written as usual.");
+    outputDither->appendOption("Off");
+    outputDither->appendOption("Ordered (8x8 Bayer)");
+    outputDither->appendOption("Blue Noise (64x64)");
+    outputDither->setDefault(kDitherOff);
+    outputDither->setAnimates(false);
+    outputDither->setParent(*ditherGroup);
+    page->addChild(*outputDither);
+
+    OFX::ChoiceParamDescriptor* ditherBits = desc.defineChoiceParam("ditherBits");
+    ditherBits->setLabel("Target Depth");
+    ditherBits->setHint("Levels to quantize to. 8-bit outputs always use 8 bits; 16-bit outputs hold the "
+                        "levels scaled to full range, half and float outputs level / (2^bits - 1).");
+    ditherBits->appendOption("8-bit");
+    ditherBits->appendOption("10-bit");
+    ditherBits->setDefault(0);
+    ditherBits->setAnimates(false);
+    ditherBits->setParent(*ditherGroup);
+    page->addChild(*ditherBits);
+
+    // Wedge
+    OFX::GroupParamDescriptor* wedgeGroup = desc.defineGroupParam("wedgeGroup");
+    wedgeGroup->setLabel("Wedge");
+    wedgeGroup->setOpen(false);
+    page->addChild(*wedgeGroup);
+
+    OFX::BooleanParamDescriptor* wedge = desc.defineBooleanParam("wedge");
+    wedge->setLabel("Wedge Contact Sheet");
+    wedge->setHint("Replaces the output with a contact sheet of grade variants, each cell showing the whole "
+                   "frame scaled down. Every source row is read once for all cells.");
+    wedge->setDefault(false);
+    wedge->setParent(*wedgeGroup);
+    page->addChild(*wedge);
+
+    OFX::IntParamDescriptor* wedgeCount = desc.defineIntParam("wedgeCount");
+    wedgeCount->setLabel("Variants");
+    wedgeCount->setRange(2, kMaxWedgeCount);
+    wedgeCount->setDisplayRange(2, kMaxWedgeCount);
+    wedgeCount->setDefault(9);
+    wedgeCount->setParent(*wedgeGroup);
+    page->addChild(*wedgeCount);
+
+    OFX::ChoiceParamDescriptor* wedgeTarget = desc.defineChoiceParam("wedgeTarget");
+    wedgeTarget->setLabel("Vary");
+    wedgeTarget->appendOption("Shadow Exponents");
+    wedgeTarget->appendOption("Highlight Exponents");
+    wedgeTarget->appendOption("Preserve Midgray");
+    wedgeTarget->setDefault(kWedgeShadow);
+    wedgeTarget->setParent(*wedgeGroup);
+    page->addChild(*wedgeTarget);
+
+    OFX::DoubleParamDescriptor* wedgeSpread = desc.defineDoubleParam("wedgeSpread");
+    wedgeSpread->setLabel("Spread");
+    wedgeSpread->setHint("Variants run from the current value minus Spread to plus Spread, left to right "
+                         "and top to bottom.");
+    wedgeSpread->setRange(0.0, 1.8);
+    wedgeSpread->setDisplayRange(0.0, 1.0);
+    wedgeSpread->setDefault(0.5);
+    wedgeSpread->setIncrement(0.05);
+    wedgeSpread->setParent(*wedgeGroup);
+    page->addChild(*wedgeSpread);
+
+    // Diagnostics
+    OFX::GroupParamDescriptor* diagnostics = desc.defineGroupParam("diagnostics");
+    diagnostics->setLabel("Diagnostics");
+    diagnostics->setOpen(false);
+    page->addChild(*diagnostics);
+
+    OFX::PushButtonParamDescriptor* report = desc.definePushButtonParam("reportPerformance");
+    report->setLabel("Report Performance");
+    report->setHint("Shows render counts, throughput and latency collected since the instance was created.");
+    report->setParent(*diagnostics);
+    page->addChild(*report);
+
+    OFX::StringParamDescriptor* reportFile = desc.defineStringParam("perfReportFile");
+    reportFile->setLabel("Report JSON File");
+    reportFile->setHint("When set, Report Performance also writes the statistics as JSON to this file.");
+    reportFile->setStringType(OFX::eStringTypeFilePath);
+    reportFile->setFilePathExists(false);
+    reportFile->setAnimates(false);
+    reportFile->setEvaluateOnChange(false);
+    reportFile->setParent(*diagnostics);
+    page->addChild(*reportFile);
+
+    OFX::BooleanParamDescriptor* hwCounters = desc.defineBooleanParam("hardwareCounters");
+    hwCounters->setLabel("Hardware Counters");
+    hwCounters->setHint("Adds CPU cycles, instructions, LLC misses and branch mispredicts per pixel "
+                        "(Linux perf_event_open) to the performance report. SplitToneBench measures the "
+                        "STREAM bandwidth to compare the reported kernel bandwidth against.");
+    hwCounters->setDefault(false);
+    hwCounters->setAnimates(false);
+    hwCounters->setEvaluateOnChange(false);
+    hwCounters->setParent(*diagnostics);
+    page->addChild(*hwCounters);
+
+    OFX::ChoiceParamDescriptor* threading = desc.defineChoiceParam("threading");
+    threading->setLabel("Threading");
+    threading->setHint("Who provides the render threads. OpenMP and TBB are only available when the plugin "
+                       "is built with them; otherwise they use the host suite. Output is identical.");
+    threading->appendOption("Host Suite");
+    threading->appendOption("Built-in Pool");
+    threading->appendOption("OpenMP");
+    threading->appendOption("TBB");
+    threading->setDefault(SPLITTONE_DEFAULT_THREADING);
+    threading->setAnimates(false);
+    threading->setEvaluateOnChange(false);
+    threading->setParent(*diagnostics);
+    page->addChild(*threading);
+
+    // Not shown: which kParamsVersion the saved values follow (0 for projects from before 1.1).
+    OFX::IntParamDescriptor* paramsVersion = desc.defineIntParam("paramsVersion");
+    paramsVersion->setDefault(0);
+    paramsVersion->setIsSecret(true);
+    paramsVersion->setAnimates(false);
+    paramsVersion->setEvaluateOnChange(false);
   }
 
   OFX::ImageEffect* createInstance(OfxImageEffectHandle handle, OFX::ContextEnum /*context*/) override {
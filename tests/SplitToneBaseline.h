@@ -0,0 +1,260 @@
+// Split Tone v2 benchmark baselines
+// A baseline is SplitToneBench's output written out as JSON: the per-render throughputs of every
+// synthetic configuration, each tagged with its kernel, depth, frame size and threading. Comparing
+// a later run against it pairs configurations by tag only, and uses a one-sided Mann-Whitney U
+// test per pair, so a regression is only flagged when the slowdown is both larger than the
+// threshold and unlikely to be noise. Include after SplitTone_v2.cpp.
+
+#ifndef SPLITTONE_BASELINE_H
+#define SPLITTONE_BASELINE_H
+
+static const int kBaselineFormat = 2;
+
+// Per-render throughputs, in pixels/second, of one benchmark configuration.
+struct BenchSamples {
+  std::string tag; // "<kernel>/<depth>/<width>x<height>/<backend>/<threads>"
+  std::vector<double> samples;
+};
+
+struct Baseline {
+  std::string version; // plugin version that recorded it
+  std::vector<BenchSamples> configs;
+};
+
+static inline std::string formatBaselineJson(const std::vector<BenchSamples>& configs) {
+  std::ostringstream os;
+  os.precision(std::numeric_limits<double>::max_digits10); // samples read back exactly
+  os << "{\n"
+     << "  \"format\": " << kBaselineFormat << ",\n"
+     << "  \"plugin\": \"" << kPluginIdentifier << "\",\n"
+     << "  \"version\": \"" << kPluginVersionMajor << "." << kPluginVersionMinor << "\",\n"
+     << "  \"unit\": \"pixels/s\",\n"
+     << "  \"configs\": [";
+  for (std::size_t c = 0; c < configs.size(); ++c) {
+    os << (c ? "," : "") << "\n    {\"tag\": \"" << configs[c].tag << "\", \"samples\": [";
+    for (std::size_t i = 0; i < configs[c].samples.size(); ++i) os << (i ? ", " : "") << configs[c].samples[i];
+    os << "]}";
+  }
+  os << "\n  ]\n}\n";
+  return os.str();
+}
+
+// Reader for files written by formatBaselineJson(). Whitespace and member order are free, but
+// anything else that formatBaselineJson() would not write (unknown members, strings with escapes,
+// missing or non-positive samples, repeated tags, trailing text) rejects the whole file.
+class BaselineParser {
+public:
+  explicit BaselineParser(const std::string& text) : _p(text.c_str()), _end(text.c_str() + text.size()) {}
+
+  bool parse(Baseline& out) {
+    out = Baseline();
+    bool haveFormat = false;
+    bool haveConfigs = false;
+    if (!members([&](const std::string& key) {
+          if (key == "format") {
+            double format = 0.0;
+            haveFormat = number(format) && format == kBaselineFormat;
+            return haveFormat;
+          }
+          if (key == "version") return string(out.version);
+          if (key == "plugin" || key == "unit") {
+            std::string ignored;
+            return string(ignored);
+          }
+          if (key == "configs") {
+            haveConfigs = configs(out.configs);
+            return haveConfigs;
+          }
+          return false;
+        })) {
+      return false;
+    }
+    skipSpace();
+    return haveFormat && haveConfigs && _p == _end;
+  }
+
+private:
+  void skipSpace() {
+    while (_p < _end && (*_p == ' ' || *_p == '\t' || *_p == '\n' || *_p == '\r')) ++_p;
+  }
+
+  bool consume(char c) {
+    skipSpace();
+    if (_p == _end || *_p != c) return false;
+    ++_p;
+    return true;
+  }
+
+  bool string(std::string& out) {
+    if (!consume('"')) return false;
+    const char* begin = _p;
+    while (_p < _end && *_p != '"') {
+      if (*_p == '\\') return false;
+      ++_p;
+    }
+    if (_p == _end) return false;
+    out.assign(begin, _p);
+    ++_p;
+    return true;
+  }
+
+  bool number(double& out) {
+    skipSpace();
+    if (_p == _end) return false;
+    // strtod needs a terminator it cannot run past; the text is a std::string, so it has one.
+    char* next = nullptr;
+    out = std::strtod(_p, &next);
+    if (next == _p || next > _end || !std::isfinite(out)) return false;
+    _p = next;
+    return true;
+  }
+
+  // "{" key ":" value ("," key ":" value)* "}", each value read by member(key).
+  template <class Member>
+  bool members(const Member& member) {
+    if (!consume('{')) return false;
+    if (consume('}')) return true;
+    do {
+      std::string key;
+      if (!string(key) || !consume(':') || !member(key)) return false;
+    } while (consume(','));
+    return consume('}');
+  }
+
+  bool configs(std::vector<BenchSamples>& out) {
+    if (!consume('[')) return false;
+    do {
+      BenchSamples config;
+      bool haveTag = false;
+      if (!members([&](const std::string& key) {
+            if (key == "tag") {
+              haveTag = string(config.tag);
+              return haveTag;
+            }
+            if (key == "samples") return samples(config.samples);
+            return false;
+          })) {
+        return false;
+      }
+      if (!haveTag || config.samples.empty()) return false;
+      for (const BenchSamples& other : out) {
+        if (other.tag == config.tag) return false;
+      }
+      out.push_back(config);
+    } while (consume(','));
+    return consume(']');
+  }
+
+  bool samples(std::vector<double>& out) {
+    if (!consume('[')) return false;
+    do {
+      double v = 0.0;
+      if (!number(v) || v <= 0.0) return false;
+      out.push_back(v);
+    } while (consume(','));
+    return consume(']');
+  }
+
+  const char* _p;
+  const char* const _end;
+};
+
+static inline bool parseBaselineJson(const std::string& text, Baseline& out) {
+  return BaselineParser(text).parse(out);
+}
+
+static inline bool readBaselineFile(const std::string& path, Baseline& out) {
+  std::ifstream in(path.c_str());
+  if (!in) return false;
+  std::stringstream buf;
+  buf << in.rdbuf();
+  return parseBaselineJson(buf.str(), out);
+}
+
+static inline double median(std::vector<double> v) {
+  if (v.empty()) return 0.0;
+  std::sort(v.begin(), v.end());
+  const std::size_t n = v.size();
+  return n % 2 ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+}
+
+// One-sided Mann-Whitney U test (normal approximation with tie correction).
+// Returns the p-value for "current tends to be lower than baseline".
+static inline double mannWhitneyLowerP(const std::vector<double>& current, const std::vector<double>& baseline) {
+  const std::size_t n1 = current.size();
+  const std::size_t n2 = baseline.size();
+  if (!n1 || !n2) return 1.0;
+
+  std::vector<std::pair<double, int>> all;
+  all.reserve(n1 + n2);
+  for (double v : current) all.push_back(std::make_pair(v, 0));
+  for (double v : baseline) all.push_back(std::make_pair(v, 1));
+  std::sort(all.begin(), all.end());
+
+  // Average ranks over ties, accumulating the tie correction term sum(t^3 - t).
+  const double n = (double)(n1 + n2);
+  double rankSumCurrent = 0.0;
+  double tieTerm = 0.0;
+  for (std::size_t i = 0; i < all.size();) {
+    std::size_t j = i;
+    while (j < all.size() && all[j].first == all[i].first) ++j;
+    const double avgRank = 0.5 * (double)(i + 1 + j);
+    for (std::size_t k = i; k < j; ++k) if (all[k].second == 0) rankSumCurrent += avgRank;
+    const double t = (double)(j - i);
+    tieTerm += t * t * t - t;
+    i = j;
+  }
+
+  const double u = rankSumCurrent - (double)n1 * (double)(n1 + 1) / 2.0;
+  const double mean = (double)n1 * (double)n2 / 2.0;
+  const double var = (double)n1 * (double)n2 / 12.0 * ((n + 1.0) - tieTerm / (n * (n - 1.0)));
+  if (var <= 0.0) return 1.0;
+  const double z = (u - mean + 0.5) / std::sqrt(var); // continuity correction towards the mean
+  return 0.5 * std::erfc(-z / std::sqrt(2.0));
+}
+
+// One line per configuration of the current run; configurations missing from either side are
+// listed but never count as a regression.
+static inline std::string formatBaselineComparison(const std::vector<BenchSamples>& current,
+                                                   const Baseline& baseline,
+                                                   double thresholdPercent,
+                                                   bool& regression) {
+  std::ostringstream os;
+  os.setf(std::ios::fixed);
+  os << "Split Tone v2 baseline comparison against plugin "
+     << (baseline.version.empty() ? "?" : baseline.version) << " (threshold -";
+  os.precision(2);
+  os << thresholdPercent << "%, p < 0.05)\n";
+  regression = false;
+  for (const BenchSamples& cur : current) {
+    const BenchSamples* base = nullptr;
+    for (const BenchSamples& b : baseline.configs) {
+      if (b.tag == cur.tag) base = &b;
+    }
+    os << cur.tag << ": ";
+    if (!base) {
+      os << "not in the baseline\n";
+      continue;
+    }
+    const double curMed = median(cur.samples);
+    const double baseMed = median(base->samples);
+    const double change = baseMed > 0.0 ? (curMed / baseMed - 1.0) * 100.0 : 0.0;
+    const double p = mannWhitneyLowerP(cur.samples, base->samples);
+    const bool regressed = change < -thresholdPercent && p < 0.05;
+    regression = regression || regressed;
+    os.precision(2);
+    os << baseMed * 1e-6 << " -> " << curMed * 1e-6 << " Mpix/s median (" << base->samples.size() << " vs "
+       << cur.samples.size() << " renders), change " << change << "%, Mann-Whitney p = ";
+    os.precision(4);
+    os << p << (regressed ? " REGRESSION" : "") << "\n";
+  }
+  for (const BenchSamples& b : baseline.configs) {
+    bool measured = false;
+    for (const BenchSamples& cur : current) measured = measured || cur.tag == b.tag;
+    if (!measured) os << b.tag << ": in the baseline only\n";
+  }
+  os << (regression ? "REGRESSION: throughput dropped beyond the threshold\n" : "No significant regression\n");
+  return os.str();
+}
+
+#endif
@@ -0,0 +1,212 @@
+// Split Tone v2 benchmark
+// A fixed synthetic workload timed through SplitToneRenderer, away from any host: every
+// configuration (kernel x depth x frame size x threading backend) renders the same frame, on all
+// CPUs or, for the scaling reference, on one thread. The memory
+// ceiling comes from a STREAM-style triad measured first, so each configuration's achieved
+// bandwidth can be placed on the roofline. The per-render throughputs can be saved as a baseline
+// and later runs compared against it (see SplitToneBaseline.h); the exit status is 1 on a
+// regression. Not a ctest: it takes a while and its numbers depend on the machine.
+//
+//   SplitToneBench [--save <baseline.json>] [--compare <baseline.json>] [--threshold <percent>]
+
+#include "../SplitTone_v2.cpp"
+#include "SplitToneBaseline.h"
+#include "SplitToneFixtures.h"
+
+#include <cstdio>
+#include <functional>
+
+// STREAM-style triad (a = b + s*c) over arrays far larger than the last-level cache, run on all
+// cores. This is the roofline's memory ceiling the kernel's achieved bandwidth is compared against.
+static double measureStreamBandwidth() {
+  const std::size_t n = std::size_t(1) << 24; // 64 MB per array
+  const unsigned nThreads = std::max(1u, std::thread::hardware_concurrency());
+  std::unique_ptr<float[]> a(new float[n]), b(new float[n]), c(new float[n]);
+
+  auto forEachSlice = [&](const std::function<void(std::size_t, std::size_t)>& fn) {
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < nThreads; ++t) {
+      threads.emplace_back([&, t] { fn(n * t / nThreads, n * (t + 1) / nThreads); });
+    }
+    for (auto& th : threads) th.join();
+  };
+
+  // First touch from the same threads that run the triad, so pages land on their NUMA nodes.
+  forEachSlice([&](std::size_t i0, std::size_t i1) {
+    for (std::size_t i = i0; i < i1; ++i) { a[i] = 0.0f; b[i] = 1.0f; c[i] = 2.0f; }
+  });
+
+  double best = 0.0;
+  for (int rep = 0; rep < 5; ++rep) {
+    const auto t0 = std::chrono::steady_clock::now();
+    forEachSlice([&](std::size_t i0, std::size_t i1) {
+      float* pa = a.get(); const float* pb = b.get(); const float* pc = c.get();
+      for (std::size_t i = i0; i < i1; ++i) pa[i] = pb[i] + 3.0f * pc[i];
+    });
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    if (secs > 0.0) best = std::max(best, 3.0 * sizeof(float) * (double)n / secs);
+  }
+  return best;
+}
+
+struct BenchConfig {
+  const char* kernelName;
+  int kernel;
+  OFX::BitDepthEnum depth; // source and destination
+  int width;
+  int height;
+  int threading;        // a non-host backend; configurations it is not built into are skipped
+  unsigned int threads; // 0: all CPUs
+};
+
+static const char* depthName(OFX::BitDepthEnum depth) {
+  switch (depth) {
+  case OFX::eBitDepthUByte: return "8bit";
+  case OFX::eBitDepthUShort: return "16bit";
+  case OFX::eBitDepthHalf: return "half";
+  default: return "float";
+  }
+}
+
+static const char* threadingName(int backend) {
+  switch (backend) {
+  case kThreadingOpenMP: return "openmp";
+  case kThreadingTbb: return "tbb";
+  default: return "pool";
+  }
+}
+
+static const BenchConfig kBenchConfigs[] = {
+  {"reference", kKernelReference, OFX::eBitDepthFloat, 1920, 1080, kThreadingPool, 0},
+  {"fast", kKernelFast, OFX::eBitDepthFloat, 1920, 1080, kThreadingPool, 0},
+  {"reference", kKernelReference, OFX::eBitDepthHalf, 1920, 1080, kThreadingPool, 0},
+  {"reference", kKernelReference, OFX::eBitDepthUShort, 1920, 1080, kThreadingPool, 0},
+  {"fast", kKernelFast, OFX::eBitDepthUByte, 1920, 1080, kThreadingPool, 0},
+  {"reference", kKernelReference, OFX::eBitDepthFloat, 3840, 2160, kThreadingPool, 0},
+  // Threading backends: the same UHD frame on one thread, then through each backend on all CPUs.
+  {"fast", kKernelFast, OFX::eBitDepthFloat, 3840, 2160, kThreadingPool, 1},
+  {"fast", kKernelFast, OFX::eBitDepthFloat, 3840, 2160, kThreadingPool, 0},
+  {"fast", kKernelFast, OFX::eBitDepthFloat, 3840, 2160, kThreadingOpenMP, 0},
+  {"fast", kKernelFast, OFX::eBitDepthFloat, 3840, 2160, kThreadingTbb, 0},
+};
+
+static const int kBenchWarmRenders = 3;
+static const int kBenchRenders = 21;
+
+// Kernel throughput, in pixels/second, of each timed render of one configuration.
+static std::vector<double> runConfig(const BenchConfig& c) {
+  const OfxRectI bounds = {0, 0, c.width, c.height};
+  std::vector<unsigned char> srcPixels, dstPixels;
+  const ImageView src = makeView(srcPixels, c.depth, bounds);
+  const ImageView dst = makeView(dstPixels, c.depth, bounds);
+
+  // The validation inputs spread over the frame: every zone of the curve, a few transparent pixels.
+  const std::vector<float> inputs = validationInputs();
+  std::vector<float> row((std::size_t)c.width * 4);
+  for (int y = 0; y < c.height; ++y) {
+    for (std::size_t i = 0; i < row.size(); ++i) {
+      row[i] = inputs[((std::size_t)y * row.size() + i) * 2654435761u % inputs.size()];
+    }
+    storeRow(c.depth, row.data(), src.getPixelAddress(0, y), c.width);
+  }
+
+  SplitToneRenderer renderer;
+  RenderRequest req;
+  req.window = bounds;
+  req.threading = c.threading;
+  req.cpus = c.threads ? c.threads : std::max(1u, std::thread::hardware_concurrency());
+  req.params.kernel = c.kernel;
+  req.params.preserveMidgray = 0.25f;
+  req.params.pHighlight[1] = 1.4f;
+
+  std::vector<double> samples;
+  for (int i = 0; i < kBenchWarmRenders + kBenchRenders; ++i) {
+    req.time = (double)i;
+    const uint64_t t0 = steadyNanos();
+    renderer.render(src, dst, req);
+    const uint64_t nanos = steadyNanos() - t0;
+    if (i >= kBenchWarmRenders && nanos) samples.push_back((double)c.width * c.height / ((double)nanos * 1e-9));
+  }
+  return samples;
+}
+
+// "<kernel>/<depth>/<width>x<height>" names the frame, "/<backend>/<threads>" how it was spread.
+static std::string frameTag(const BenchConfig& c) {
+  return std::string(c.kernelName) + "/" + depthName(c.depth) + "/" + std::to_string(c.width) + "x" +
+         std::to_string(c.height);
+}
+
+static std::string configTag(const BenchConfig& c) {
+  return frameTag(c) + "/" + threadingName(c.threading) + "/" + (c.threads ? std::to_string(c.threads) : "all");
+}
+
+int main(int argc, char** argv) {
+  std::string savePath, comparePath;
+  double threshold = 5.0;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--save" && i + 1 < argc) {
+      savePath = argv[++i];
+    } else if (arg == "--compare" && i + 1 < argc) {
+      comparePath = argv[++i];
+    } else if (arg == "--threshold" && i + 1 < argc) {
+      threshold = std::atof(argv[++i]);
+    } else {
+      std::fprintf(stderr, "usage: %s [--save <baseline.json>] [--compare <baseline.json>] [--threshold <percent>]\n",
+                   argv[0]);
+      return 2;
+    }
+  }
+
+  // Read first, so a bad path fails before the run rather than after it.
+  Baseline baseline;
+  if (!comparePath.empty() && !readBaselineFile(comparePath, baseline)) {
+    std::fprintf(stderr, "Could not read a format %d baseline from %s\n", kBaselineFormat, comparePath.c_str());
+    return 2;
+  }
+
+  const double stream = measureStreamBandwidth();
+  std::printf("STREAM triad: %.2f GB/s on %u threads\n", stream * 1e-9,
+              std::max(1u, std::thread::hardware_concurrency()));
+
+  std::vector<BenchSamples> results;
+  std::vector<std::pair<std::string, double>> oneThread; // frame tag, median pixels/second
+  for (const BenchConfig& c : kBenchConfigs) {
+    BenchSamples result;
+    result.tag = configTag(c);
+    if (!threadingAvailable(c.threading)) {
+      std::printf("%-36s not built in\n", result.tag.c_str());
+      continue;
+    }
+    result.samples = runConfig(c);
+    const double pixelsPerSec = median(result.samples);
+    const double bytesPerPixel = 2.0 * 4.0 * bytesPerComponent(c.depth);
+    const double achieved = pixelsPerSec * bytesPerPixel;
+    const double ratio = stream > 0.0 ? achieved / stream : 0.0;
+    std::printf("%-36s %8.2f Mpix/s, %6.2f GB/s (%2.0f B/pixel), %5.1f%% of STREAM -> %s", result.tag.c_str(),
+                pixelsPerSec * 1e-6, achieved * 1e-9, bytesPerPixel, 100.0 * ratio,
+                ratio >= 0.6 ? "memory-bound" : "compute-bound");
+    if (c.threads == 1) oneThread.push_back(std::make_pair(frameTag(c), pixelsPerSec));
+    for (const auto& single : oneThread) {
+      if (c.threads != 1 && single.first == frameTag(c)) std::printf(", %.2fx one thread", pixelsPerSec / single.second);
+    }
+    std::printf("\n");
+    results.push_back(result);
+  }
+
+  if (!savePath.empty()) {
+    std::ofstream out(savePath.c_str(), std::ios::out | std::ios::trunc);
+    out << formatBaselineJson(results);
+    if (!out) {
+      std::fprintf(stderr, "Could not write %s\n", savePath.c_str());
+      return 2;
+    }
+    std::printf("Baseline written to %s\n", savePath.c_str());
+  }
+
+  bool regression = false;
+  if (!comparePath.empty()) {
+    std::printf("\n%s", formatBaselineComparison(results, baseline, threshold, regression).c_str());
+  }
+  return regression ? 1 : 0;
+}
@@ -0,0 +1,44 @@
+// Split Tone v2 test fixtures
+// Inputs and image views shared by SplitToneTests and SplitToneBench. Include after SplitTone_v2.cpp.
+
+#ifndef SPLITTONE_FIXTURES_H
+#define SPLITTONE_FIXTURES_H
+
+// Every half-float bit pattern, every 16-bit code value, random values from below 0 to above 1,
+// and the special values (NaN, +-Inf, -0, denormals).
+static inline std::vector<float> validationInputs() {
+  std::vector<float> v;
+  v.reserve(3 * 65536 + 16);
+  for (uint32_t h = 0; h < 65536; ++h) v.push_back(halfToFloat((uint16_t)h));
+  for (uint32_t code = 0; code < 65536; ++code) v.push_back((float)code / 65535.0f);
+
+  uint32_t state = 0x9e3779b9u; // xorshift32, fixed seed so reports are comparable
+  for (int i = 0; i < 65536; ++i) {
+    state ^= state << 13; state ^= state >> 17; state ^= state << 5;
+    v.push_back(-0.25f + 1.75f * (float)(state >> 8) * (1.0f / 16777216.0f));
+  }
+
+  const float specials[] = {
+    std::numeric_limits<float>::quiet_NaN(), std::numeric_limits<float>::infinity(),
+    -std::numeric_limits<float>::infinity(), -0.0f, std::numeric_limits<float>::denorm_min(),
+    std::numeric_limits<float>::min(), std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(),
+    1.0f, std::nextafter(1.0f, 2.0f), std::nextafter(1.0f, 0.0f)
+  };
+  v.insert(v.end(), std::begin(specials), std::end(specials));
+  return v;
+}
+
+// An image view over storage, which is sized (and left uninitialized) for it.
+static inline ImageView makeView(std::vector<unsigned char>& storage, OFX::BitDepthEnum depth, const OfxRectI& bounds) {
+  ImageView v;
+  v.bounds = bounds;
+  v.rod = bounds;
+  v.depth = depth;
+  v.pixelBytes = 4 * bytesPerComponent(depth);
+  v.rowBytes = (std::ptrdiff_t)(bounds.x2 - bounds.x1) * v.pixelBytes;
+  storage.resize((std::size_t)v.rowBytes * (std::size_t)(bounds.y2 - bounds.y1));
+  v.data = (char*)storage.data();
+  return v;
+}
+
+#endif
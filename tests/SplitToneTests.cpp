@@ -0,0 +1,1552 @@
+// Split Tone v2 tests
+// The plugin source is compiled into this executable so every internal function is reachable
+// without exporting anything from the .ofx. Each case is one ctest (see CMakeLists.txt): run
+// SplitToneTests <case>, which prints a report and exits non-zero on failure. None of them need a
+// host, so they only use the non-host threading backends.
+
+#include "../SplitTone_v2.cpp"
+#include "SplitToneBaseline.h"
+#include "SplitToneFixtures.h"
+
+#include <cstdio>
+
+// Every heap allocation in this executable goes through here, for the allocations test. The
+// replacements stay out of line: inlined, GCC pairs a new-expression with the free() inside them
+// and warns (-Wmismatched-new-delete) about a mismatch that is not there.
+#if defined(_MSC_VER)
+#define SPLITTONE_NOINLINE __declspec(noinline)
+#else
+#define SPLITTONE_NOINLINE __attribute__((noinline))
+#endif
+
+static std::atomic<uint64_t> gHeapAllocations{0};
+
+SPLITTONE_NOINLINE void* operator new(std::size_t bytes) {
+  gHeapAllocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(bytes ? bytes : 1)) return p;
+  throw std::bad_alloc();
+}
+SPLITTONE_NOINLINE void* operator new[](std::size_t bytes) { return operator new(bytes); }
+SPLITTONE_NOINLINE void operator delete(void* p) noexcept { std::free(p); }
+SPLITTONE_NOINLINE void operator delete[](void* p) noexcept { std::free(p); }
+SPLITTONE_NOINLINE void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+SPLITTONE_NOINLINE void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+// The unspecialized kernels the specialized ones must match, and the whole LUT path as a row kernel
+// (coordinates and tables built per call).
+static int processRowScalar(const float* src, float* dst, int n, const CurveSetup& c) {
+  return processRow<StdPow>(src, dst, n, c);
+}
+
+static int processRowDeterministic(const float* src, float* dst, int n, const CurveSetup& c) {
+  return processRow<PortablePow>(src, dst, n, c);
+}
+
+static int processRowLut(const float* src, float* dst, int n, const CurveSetup& c) {
+  thread_local std::vector<float> tables(kCurveLutFloats);
+  thread_local std::vector<uint32_t> coords;
+  coords.resize((std::size_t)n * 3);
+  const CurveLut lut = makeCurveLut(tables.data(), c);
+  lutCoordinatesRow(src, coords.data(), n, c);
+  return gatherRow(src, dst, coords.data(), n, lut);
+}
+
+// Every row kernel the processor can dispatch to. Each one is checked against applyCurve by the
+// kernels test; tolerance is the largest absolute error it may show on finite outputs.
+// Variants in the same deterministic family must produce the same bits as each other.
+struct RowKernelVariant {
+  const char* name;
+  RowKernelFn fn;
+  float tolerance;
+  const char* family; // nullptr: not reproducible across machines
+};
+
+static std::vector<RowKernelVariant> rowKernelVariants() {
+  std::vector<RowKernelVariant> v;
+  v.push_back({"scalar", processRowScalar, 0.0f, nullptr});
+  v.push_back({"deterministic", processRowDeterministic, 1e-6f, "reference"});
+  v.push_back({"scalar-specialized", processRowScalarSpecialized, 0.0f, nullptr});
+  v.push_back({"deterministic-specialized", processRowDeterministicSpecialized, 1e-6f, "reference"});
+  v.push_back({"fast", processRowFast, 1e-6f, "fast"});
+#ifdef SPLITTONE_X86_DISPATCH
+  if (cpuHasAvx2()) {
+    v.push_back({"fast-avx2", processRowFastAvx2, 1e-6f, "fast"});
+    v.push_back({"fast-avx2-fma", processRowFastAvx2Fma, 1e-6f, nullptr});
+  }
+  if (cpuHasAvx512()) {
+    v.push_back({"fast-avx512", processRowFastAvx512, 1e-6f, "fast"});
+    v.push_back({"fast-avx512-fma", processRowFastAvx512Fma, 1e-6f, nullptr});
+  }
+#endif
+  v.push_back({"lut", processRowLut, 1e-5f, nullptr});
+  return v;
+}
+
+// kernels: differential accuracy check of every row kernel against the scalar applyCurve
+// reference, over validationInputs() and a grid of presets, preserve amounts and the full slider
+// exponent range. Errors are bucketed by input zone.
+enum InputZone { kZoneNegative, kZoneShadow, kZoneMid, kZoneHighlight, kZoneAboveOne, kZoneNonFinite, kZoneCount };
+
+static const char* const kZoneNames[kZoneCount] = {
+  "negative", "shadows", "mids", "highlights", "above 1", "NaN/Inf"
+};
+
+static inline int classifyZone(float x, float shadowEnd, float highlightStart) {
+  if (!std::isfinite(x)) return kZoneNonFinite;
+  if (x < 0.0f) return kZoneNegative;
+  if (x <= shadowEnd) return kZoneShadow;
+  if (x <= highlightStart) return kZoneMid;
+  if (x <= 1.0f) return kZoneHighlight;
+  return kZoneAboveOne;
+}
+
+struct ErrorStats {
+  uint64_t count = 0;
+  uint64_t mismatches = 0; // non-finite disagreements and alpha changes
+  double maxAbs = 0.0;
+  double sumAbs = 0.0;
+  double maxRel = 0.0;
+
+  void add(float out, float ref) {
+    ++count;
+    if (std::isnan(ref) || std::isnan(out) || std::isinf(ref) || std::isinf(out)) {
+      if (!(std::isnan(ref) && std::isnan(out)) && out != ref) ++mismatches;
+      return;
+    }
+    const double err = std::fabs((double)out - (double)ref);
+    maxAbs = std::max(maxAbs, err);
+    sumAbs += err;
+    if (std::fabs(ref) > 1e-6f) maxRel = std::max(maxRel, err / std::fabs((double)ref));
+  }
+
+  void merge(const ErrorStats& o) {
+    count += o.count;
+    mismatches += o.mismatches;
+    maxAbs = std::max(maxAbs, o.maxAbs);
+    sumAbs += o.sumAbs;
+    maxRel = std::max(maxRel, o.maxRel);
+  }
+};
+
+static bool testKernels() {
+  const std::vector<RowKernelVariant> variants = rowKernelVariants();
+  const std::vector<float> inputs = validationInputs();
+  const int n = (int)inputs.size();
+
+  // Slider range is 0.2..2.0 (see makeSlider). Each pass gives R, G and B a different
+  // (shadow, highlight) exponent pair, so all pairs are covered in a third of the passes.
+  const float exponents[] = {0.2f, 0.35f, 0.5f, 0.75f, 1.0f, 1.25f, 1.5f, 2.0f};
+  const int nExp = (int)(sizeof(exponents) / sizeof(exponents[0]));
+  const int nPairs = nExp * nExp;
+  const int presets[] = {0, 9, 19};
+  const float preserves[] = {0.0f, 0.5f, 1.0f};
+
+  std::vector<ParamsSnapshot> configs;
+  for (int preset : presets) {
+    for (float preserve : preserves) {
+      for (int pair = 0; pair < nPairs; pair += 3) {
+        ParamsSnapshot p;
+        p.preset = preset;
+        p.preserveMidgray = preserve;
+        for (int ch = 0; ch < 3; ++ch) {
+          const int k = (pair + ch) % nPairs;
+          p.pShadow[ch] = exponents[k / nExp];
+          p.pHighlight[ch] = exponents[k % nExp];
+        }
+        configs.push_back(p);
+      }
+    }
+  }
+
+  const std::size_t nVariants = variants.size();
+  const unsigned nThreads = std::max(1u, std::min<unsigned>(std::thread::hardware_concurrency(), (unsigned)configs.size()));
+  std::vector<std::vector<ErrorStats>> perThread(nThreads, std::vector<ErrorStats>(nVariants * kZoneCount));
+
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < nThreads; ++t) {
+    threads.emplace_back([&, t] {
+      std::vector<float> src((std::size_t)n * 4), dst((std::size_t)n * 4);
+      for (int i = 0; i < n; ++i) for (int ch = 0; ch < 4; ++ch) src[(std::size_t)i * 4 + ch] = inputs[i];
+      std::vector<ErrorStats>& stats = perThread[t];
+
+      for (std::size_t ci = t; ci < configs.size(); ci += nThreads) {
+        const CurveSetup c = makeCurveSetup(configs[ci]);
+        for (std::size_t vi = 0; vi < nVariants; ++vi) {
+          variants[vi].fn(src.data(), dst.data(), n, c);
+          for (int i = 0; i < n; ++i) {
+            const float x = inputs[i];
+            ErrorStats& z = stats[vi * kZoneCount + classifyZone(x, c.shadowEnd, c.highlightStart)];
+            for (int ch = 0; ch < 3; ++ch) {
+              z.add(dst[(std::size_t)i * 4 + ch], applyCurve(x, c.shadowEnd, c.highlightStart, c.pShadow[ch], c.pHighlight[ch]));
+            }
+            if (std::memcmp(&dst[(std::size_t)i * 4 + 3], &x, sizeof(float)) != 0) ++z.mismatches;
+          }
+        }
+      }
+    });
+  }
+  for (auto& th : threads) th.join();
+
+  bool allPass = true;
+  std::ostringstream os;
+  os << "Split Tone v2 kernel validation (" << n << " inputs x " << configs.size() << " parameter sets)\n";
+  for (std::size_t vi = 0; vi < nVariants; ++vi) {
+    ErrorStats zones[kZoneCount];
+    ErrorStats all;
+    for (unsigned t = 0; t < nThreads; ++t) {
+      for (int z = 0; z < kZoneCount; ++z) zones[z].merge(perThread[t][vi * kZoneCount + z]);
+    }
+    for (int z = 0; z < kZoneCount; ++z) all.merge(zones[z]);
+
+    const bool pass = !all.mismatches && all.maxAbs <= variants[vi].tolerance;
+    allPass = allPass && pass;
+    os << variants[vi].name << ": " << (pass ? "PASS" : "FAIL")
+       << " (tolerance " << variants[vi].tolerance << ")\n";
+    for (int z = 0; z < kZoneCount; ++z) {
+      const ErrorStats& e = zones[z];
+      os << "  " << kZoneNames[z] << ": max abs " << e.maxAbs
+         << ", mean abs " << (e.count ? e.sumAbs / (double)e.count : 0.0)
+         << ", max rel " << e.maxRel;
+      if (e.mismatches) os << ", " << e.mismatches << " mismatches";
+      os << "\n";
+    }
+  }
+  std::fputs(os.str().c_str(), stdout);
+  return allPass;
+}
+
+// determinism: one synthetic frame rendered through SplitToneRenderer in deterministic mode must
+// come out with the same bits under every threading backend built in, on 1, 2 and all threads,
+// split into render windows of several shapes as host tiling would, and (on x86) with the CPU
+// dispatch limited to each instruction set below the machine's. The scenarios cover both kernels,
+// depth conversions, half tables, transparent blocks, the burned-in curve, dither, static tile
+// reuse and the wedge. The burned-in curve's columns must hash to a fixed value, and renders that
+// skip transparent blocks must also match the plain row kernel.
+static inline uint64_t fnv1a(const void* data, std::size_t bytes, uint64_t h = 1469598103934665603ull) {
+  const unsigned char* p = (const unsigned char*)data;
+  for (std::size_t i = 0; i < bytes; ++i) { h ^= p[i]; h *= 1099511628211ull; }
+  return h;
+}
+
+// Render windows covering bounds in tiles of at most w x h pixels.
+static std::vector<OfxRectI> tileWindows(const OfxRectI& bounds, int w, int h) {
+  std::vector<OfxRectI> windows;
+  for (int y = bounds.y1; y < bounds.y2; y += h) {
+    for (int x = bounds.x1; x < bounds.x2; x += w) {
+      windows.push_back({x, y, std::min(bounds.x2, x + w), std::min(bounds.y2, y + h)});
+    }
+  }
+  return windows;
+}
+
+struct DeterminismScenario {
+  const char* name;
+  OFX::BitDepthEnum srcDepth;
+  OFX::BitDepthEnum dstDepth;
+  int kernel;
+  bool burnInCurve;
+  int dither;
+  int ditherBits;
+  bool reuseStaticTiles;
+  int wedge; // variants, 0 for off
+};
+
+static bool testDeterminism() {
+  const OfxRectI bounds = {-3, 5, 248, 136}; // odd sizes so no tile shape divides the frame evenly
+  const int width = bounds.x2 - bounds.x1;
+  const int height = bounds.y2 - bounds.y1;
+
+  // Graded inputs of every kind, with a transparent black quadrant (of either sign) and, at its
+  // edge, transparent pixels that still carry color.
+  const std::vector<float> inputs = validationInputs();
+  std::vector<float> frame((std::size_t)width * height * 4);
+  for (std::size_t i = 0; i < frame.size(); ++i) frame[i] = inputs[(i * 2654435761u) % inputs.size()];
+  for (int y = 0; y < height / 2; ++y) {
+    for (int x = 0; x < width / 2; ++x) {
+      float* px = &frame[((std::size_t)y * width + x) * 4];
+      const float zero = (x + y) % 3 ? 0.0f : -0.0f;
+      px[0] = px[1] = px[2] = px[3] = zero;
+      if (x == width / 2 - 1) px[1] = 0.25f;
+    }
+  }
+
+  const DeterminismScenario scenarios[] = {
+    {"float, reference, burned-in curve", OFX::eBitDepthFloat, OFX::eBitDepthFloat, kKernelReference, true, kDitherOff, 8, false, 0},
+    {"float, fast", OFX::eBitDepthFloat, OFX::eBitDepthFloat, kKernelFast, false, kDitherOff, 8, false, 0},
+    {"half to half table", OFX::eBitDepthHalf, OFX::eBitDepthHalf, kKernelReference, false, kDitherOff, 8, false, 0},
+    {"half to float table, fast", OFX::eBitDepthHalf, OFX::eBitDepthFloat, kKernelFast, false, kDitherOff, 8, false, 0},
+    {"float to 8-bit, blue noise", OFX::eBitDepthFloat, OFX::eBitDepthUByte, kKernelReference, false, kDitherBlueNoise, 8, false, 0},
+    {"16-bit to half, ordered 10-bit, curve", OFX::eBitDepthUShort, OFX::eBitDepthHalf, kKernelFast, true, kDitherOrdered, 10, false, 0},
+    {"float to half, static tiles", OFX::eBitDepthFloat, OFX::eBitDepthHalf, kKernelFast, false, kDitherOff, 8, true, 0},
+    {"wedge to 16-bit", OFX::eBitDepthFloat, OFX::eBitDepthUShort, kKernelReference, false, kDitherOff, 8, false, 5},
+  };
+
+  struct Tiling {
+    const char* name;
+    int w, h;
+  };
+  const Tiling tilings[] = {{"full", width, height}, {"64x64", 64, 64}, {"17x13", 17, 13}, {"rows", width, 1}};
+  const unsigned int hw = std::max(1u, std::thread::hardware_concurrency());
+  const unsigned int threadCounts[] = {1u, 2u, hw};
+
+  std::vector<int> backends;
+  for (int b = 0; b < kThreadingBackendCount; ++b) {
+    if (b != kThreadingHost && threadingAvailable(b)) backends.push_back(b);
+  }
+
+  int topLevel = 0;
+  const char* const levelNames[] = {"baseline", "F16C", "AVX2", "AVX-512"};
+#ifdef SPLITTONE_X86_DISPATCH
+  topLevel = cpuHasAvx512() ? kCpuAvx512 : cpuHasAvx2() ? kCpuAvx2 : cpuHasF16c() ? kCpuF16c : kCpuBaseline;
+#endif
+
+  bool pass = true;
+  std::ostringstream os;
+  os << "Deterministic renders (" << width << "x" << height << " frame, " << backends.size()
+     << " backends, CPU dispatch up to " << levelNames[topLevel] << "):\n";
+  for (const DeterminismScenario& s : scenarios) {
+    std::vector<unsigned char> srcPixels, dstPixels;
+    const ImageView src = makeView(srcPixels, s.srcDepth, bounds);
+    const ImageView dst = makeView(dstPixels, s.dstDepth, bounds);
+    for (int y = 0; y < height; ++y) {
+      storeRow(s.srcDepth, &frame[(std::size_t)y * width * 4], src.getPixelAddress(bounds.x1, bounds.y1 + y), width);
+    }
+
+    RenderRequest req;
+    req.params.preset = 9;
+    req.params.preserveMidgray = 0.35f;
+    req.params.pShadow[0] = 0.6f; req.params.pShadow[1] = 1.0f; req.params.pShadow[2] = 1.8f;
+    req.params.pHighlight[0] = 1.7f; req.params.pHighlight[1] = 0.45f; req.params.pHighlight[2] = 1.0f;
+    req.params.deterministic = true;
+    req.params.kernel = s.kernel;
+    req.params.burnInCurve = s.burnInCurve;
+    req.dither.mode = s.dither;
+    req.dither.bits = s.ditherBits;
+    if (s.dither != kDitherOff) req.dither.pattern = ditherPattern(s.dither, req.dither.size);
+    req.reuseStaticTiles = s.reuseStaticTiles;
+    req.wedge.count = s.wedge;
+
+    bool first = true;
+    bool allEqual = true;
+    uint64_t expected = 0;
+    int configs = 0;
+    for (int level = topLevel; level >= 0; --level) {
+#ifdef SPLITTONE_X86_DISPATCH
+      cpuLevelLimit().store(level);
+      BakedCurveStore::instance().clear(); // bake the half tables with this level's kernels
+#endif
+      for (int backend : backends) {
+        for (unsigned int threads : threadCounts) {
+          for (const Tiling& tiling : tilings) {
+            // A fresh renderer per configuration: no cost estimate yet, so the first window uses
+            // every thread, and static tiles start empty. Those renders run twice, the second
+            // copying unchanged tiles.
+            SplitToneRenderer renderer;
+            req.threading = backend;
+            req.cpus = threads;
+            const std::vector<OfxRectI> windows = tileWindows(bounds, tiling.w, tiling.h);
+            for (int run = 0; run < (s.reuseStaticTiles ? 2 : 1); ++run) {
+              std::fill(dstPixels.begin(), dstPixels.end(), (unsigned char)0xa5);
+              for (const OfxRectI& w : windows) {
+                req.window = w;
+                renderer.render(src, dst, req);
+              }
+              const uint64_t h = fnv1a(dstPixels.data(), dstPixels.size());
+              if (first) {
+                expected = h;
+                first = false;
+              }
+              if (h != expected) {
+                allEqual = false;
+                os << "  MISMATCH " << s.name << ": " << kThreadingNames[backend] << ", " << threads << " threads, "
+                   << tiling.name << " windows, " << levelNames[level] << (run ? ", reused tiles" : "") << "\n";
+              }
+              ++configs;
+            }
+          }
+        }
+      }
+    }
+#ifdef SPLITTONE_X86_DISPATCH
+    cpuLevelLimit().store(kCpuAvx512);
+#endif
+    pass = pass && allEqual;
+    os << "  " << s.name << ": " << configs << " configurations, "
+       << (allEqual ? "all hashes equal" : "hashes DIFFER") << " (0x" << std::hex << expected << std::dec << ")\n";
+  }
+
+  // The burned-in curve's columns for the scenarios' grade across the frame, one past each side, as
+  // a full-frame render evaluates them. The threading, tiling and dispatch above never change which
+  // pow they use, so they are pinned to the portable pow's bits instead.
+  {
+    ParamsSnapshot p;
+    p.preset = 9;
+    p.preserveMidgray = 0.35f;
+    p.pShadow[0] = 0.6f; p.pShadow[1] = 1.0f; p.pShadow[2] = 1.8f;
+    p.pHighlight[0] = 1.7f; p.pHighlight[1] = 0.45f; p.pHighlight[2] = 1.0f;
+    const uint64_t kOverlayColumnsHash = 0x9071a9bbc25a22bdull;
+    std::vector<float> cols((std::size_t)(width + 2) * 3);
+    curveColumns(cols.data(), bounds.x1 - 1, width + 2, bounds.x1, width, makeCurveSetup(p), true);
+    const uint64_t h = fnv1a(cols.data(), cols.size() * sizeof(float));
+    pass = pass && h == kOverlayColumnsHash;
+    os << "  burned-in curve columns: " << (h == kOverlayColumnsHash ? "match" : "DIFFER from") << " the fixed hash (0x"
+       << std::hex << h << std::dec << ")\n";
+  }
+
+  // Transparent-block skipping against the plain row kernel over the same rows: blocks written
+  // without the kernel must hold exactly what it would have given them, and the alpha-0 pixels
+  // that carry color at the quadrant's edge must still be graded.
+  std::vector<unsigned char> srcPixels, dstPixels;
+  const ImageView src = makeView(srcPixels, OFX::eBitDepthFloat, bounds);
+  const ImageView dst = makeView(dstPixels, OFX::eBitDepthFloat, bounds);
+  std::memcpy(srcPixels.data(), frame.data(), srcPixels.size());
+  std::vector<float> plain(frame.size());
+  for (int kernel = kKernelReference; kernel <= kKernelFast; ++kernel) {
+    for (int deterministic = 0; deterministic < 2; ++deterministic) {
+      RenderRequest req;
+      req.params.preserveMidgray = 0.35f;
+      req.params.pShadow[0] = 0.6f; req.params.pShadow[2] = 1.8f;
+      req.params.pHighlight[0] = 1.7f; req.params.pHighlight[1] = 0.45f;
+      req.params.deterministic = deterministic != 0;
+      req.params.kernel = kernel;
+      req.threading = kThreadingPool;
+      req.cpus = hw;
+      const CurveSetup c = makeCurveSetup(req.params);
+      const RowKernelFn fn = selectRowKernel(req.params);
+      for (int y = 0; y < height; ++y) {
+        const std::size_t row = (std::size_t)y * width * 4;
+        fn(&frame[row], &plain[row], width, c);
+      }
+
+      for (const Tiling& tiling : {tilings[0], tilings[2]}) {
+        SplitToneRenderer renderer;
+        std::fill(dstPixels.begin(), dstPixels.end(), (unsigned char)0xa5);
+        for (const OfxRectI& w : tileWindows(bounds, tiling.w, tiling.h)) {
+          req.window = w;
+          renderer.render(src, dst, req);
+        }
+        const bool skipped = renderer.stats().totals().transparentPixels > 0;
+        const bool same = std::memcmp(dstPixels.data(), plain.data(), dstPixels.size()) == 0;
+        pass = pass && skipped && same;
+        os << "  transparent blocks, " << (kernel == kKernelFast ? "fast" : "reference")
+           << (deterministic ? " deterministic" : "") << ", " << tiling.name << " windows: "
+           << (!skipped ? "NOTHING SKIPPED" : same ? "identical to the plain kernel" : "DIFFERS from the plain kernel")
+           << "\n";
+      }
+    }
+  }
+  std::fputs(os.str().c_str(), stdout);
+  return pass;
+}
+
+// overlay: a render with the burned-in curve must equal the same render without it, bit for bit,
+// everywhere except the pixels its lines reach, whichever windows it is split into. Those are found
+// per pixel here, in double precision: a line reaches the pixels closer than its half width plus
+// half a pixel, each curve and the diagonal through the two segments meeting at the pixel's column.
+// Within a thousandth of a pixel of that edge either answer is accepted.
+static bool testOverlay() {
+  const OfxRectI bounds = {-7, 3, 90, 64};
+  const int width = bounds.x2 - bounds.x1;
+  const int height = bounds.y2 - bounds.y1;
+
+  // A smooth source away from 0 and 1, so that no line's paint can leave a pixel it reaches as it was.
+  std::vector<unsigned char> srcPixels, plainPixels, curvePixels;
+  const ImageView src = makeView(srcPixels, OFX::eBitDepthFloat, bounds);
+  const ImageView plain = makeView(plainPixels, OFX::eBitDepthFloat, bounds);
+  const ImageView burned = makeView(curvePixels, OFX::eBitDepthFloat, bounds);
+  for (int y = 0; y < height; ++y) {
+    float* px = (float*)src.getPixelAddress(bounds.x1, bounds.y1 + y);
+    for (int x = 0; x < width; ++x, px += 4) {
+      px[0] = 0.1f + 0.8f * (float)x / (float)width;
+      px[1] = 0.1f + 0.8f * (float)y / (float)height;
+      px[2] = 0.3f + 0.4f * (float)((x + y) % 7) / 7.0f;
+      px[3] = 1.0f;
+    }
+  }
+
+  RenderRequest req;
+  req.params.preserveMidgray = 0.35f;
+  req.params.pShadow[0] = 0.6f; req.params.pShadow[2] = 1.8f;
+  req.params.pHighlight[0] = 1.7f; req.params.pHighlight[1] = 0.45f;
+  req.threading = kThreadingPool;
+  req.cpus = 2;
+  req.window = bounds;
+  SplitToneRenderer renderer;
+  renderer.render(src, plain, req);
+
+  // Which pixels the lines reach: 1 surely, 2 within the tolerance of the edge.
+  const CurveSetup c = makeCurveSetup(req.params);
+  const double fw = width, fh = height;
+  const double kEdge = 1e-3;
+  std::vector<float> cols((std::size_t)(width + 2) * 3);
+  curveColumns(cols.data(), bounds.x1 - 1, width + 2, bounds.x1, width, c, false);
+  auto yOf = [&](double v) { return (double)bounds.y1 + (1.0 - v) * fh; };
+  auto segment = [](double px, double py, double ax, double ay, double bx, double by) {
+    const double dx = bx - ax, dy = by - ay;
+    const double t = std::max(0.0, std::min(1.0, ((px - ax) * dx + (py - ay) * dy) / (dx * dx + dy * dy)));
+    return std::hypot(px - (ax + t * dx), py - (ay + t * dy));
+  };
+  std::vector<unsigned char> reach((std::size_t)width * height, 0);
+  auto mark = [&](int x, int y, double d, double halfWidth) {
+    unsigned char& r = reach[(std::size_t)(y - bounds.y1) * width + (x - bounds.x1)];
+    if (d < halfWidth + 0.5 - kEdge) r = 1;
+    else if (d < halfWidth + 0.5 + kEdge && !r) r = 2;
+  };
+  const double lineWidth = 2.5, guideWidth = lineWidth * 0.6, verticalGuideWidth = guideWidth * fw / fh;
+  for (int y = bounds.y1; y < bounds.y2; ++y) {
+    for (int x = bounds.x1; x < bounds.x2; ++x) {
+      for (int line = 0; line < 4; ++line) {
+        auto yAt = [&](int cx) {
+          return line == 3 ? yOf((double)(cx - bounds.x1) / fw)
+                           : yOf((double)cols[(std::size_t)(cx - bounds.x1 + 1) * 3 + line]);
+        };
+        const double d = std::min(segment(x, y, x - 1, yAt(x - 1), x, yAt(x)),
+                                  segment(x, y, x, yAt(x), x + 1, yAt(x + 1)));
+        mark(x, y, d, line == 3 ? guideWidth : lineWidth);
+      }
+      for (float v : {c.shadowEnd, c.midGray, c.highlightStart}) {
+        mark(x, y, std::fabs((double)x - ((double)bounds.x1 + v * fw)), verticalGuideWidth);
+      }
+      mark(x, y, std::fabs((double)y - yOf(c.midGray)), guideWidth);
+    }
+  }
+  std::size_t reached = 0;
+  for (unsigned char r : reach) reached += r == 1;
+
+  struct Tiling {
+    const char* name;
+    int w, h;
+  };
+  const Tiling tilings[] = {{"full", width, height}, {"17x13", 17, 13}, {"rows", width, 1}};
+  req.params.burnInCurve = true;
+  bool pass = reached > 0 && reached < reach.size();
+  std::printf("Burned-in overlay on a %dx%d frame, %zu pixels reached:\n", width, height, reached);
+  for (const Tiling& tiling : tilings) {
+    std::fill(curvePixels.begin(), curvePixels.end(), (unsigned char)0xa5);
+    for (const OfxRectI& w : tileWindows(bounds, tiling.w, tiling.h)) {
+      req.window = w;
+      renderer.render(src, burned, req);
+    }
+    std::size_t strayChanges = 0, unchangedOnLine = 0, alphaChanges = 0;
+    for (int y = bounds.y1; y < bounds.y2; ++y) {
+      const float* a = (const float*)plain.getPixelAddress(bounds.x1, y);
+      const float* b = (const float*)burned.getPixelAddress(bounds.x1, y);
+      for (int x = 0; x < width; ++x, a += 4, b += 4) {
+        const unsigned char r = reach[(std::size_t)(y - bounds.y1) * width + x];
+        const bool changed = std::memcmp(a, b, 3 * sizeof(float)) != 0;
+        if (changed && !r) ++strayChanges;
+        if (!changed && r == 1) ++unchangedOnLine;
+        if (std::memcmp(a + 3, b + 3, sizeof(float)) != 0) ++alphaChanges;
+      }
+    }
+    const bool ok = !strayChanges && !unchangedOnLine && !alphaChanges;
+    std::printf("  %s windows: %zu pixels changed off the lines, %zu left unchanged on them, %zu alphas "
+                "changed%s\n", tiling.name, strayChanges, unchangedOnLine, alphaChanges, ok ? "" : " FAIL");
+    pass = pass && ok;
+  }
+  return pass;
+}
+
+// wedge: every cell of a contact sheet must hold exactly the plain row kernel's grade, under that
+// cell's makeWedgeVariant, of the source scaled down nearest-neighbour to the cell, with the cells
+// row-major from the top left. Cells past the variant count and the rows and columns left over
+// when the frame does not divide must be cleared. Checked per pixel, over several window tilings.
+static bool testWedge() {
+  const OfxRectI bounds = {-5, 2, 96, 73}; // 101x71: neither divides into the cells below
+  const int width = bounds.x2 - bounds.x1;
+  const int height = bounds.y2 - bounds.y1;
+  const std::vector<float> inputs = validationInputs();
+  std::vector<unsigned char> srcPixels, dstPixels;
+  const ImageView src = makeView(srcPixels, OFX::eBitDepthFloat, bounds);
+  const ImageView dst = makeView(dstPixels, OFX::eBitDepthFloat, bounds);
+  float* frame = (float*)srcPixels.data();
+  for (std::size_t i = 0; i < (std::size_t)width * height * 4; ++i) {
+    frame[i] = inputs[(i * 2654435761u) % inputs.size()];
+  }
+
+  const struct { int count, target; float spread; int kernel; } sheets[] = {
+    {5, kWedgeShadow, 0.5f, kKernelReference},   // 3x2 cells, one unused
+    {7, kWedgePreserve, 0.4f, kKernelFast},      // 3x3 cells, two unused
+    {4, kWedgeHighlight, 0.8f, kKernelReference} // 2x2 cells
+  };
+  struct Tiling {
+    const char* name;
+    int w, h;
+  };
+  const Tiling tilings[] = {{"full", width, height}, {"17x13", 17, 13}, {"rows", width, 1}};
+
+  bool pass = true;
+  std::printf("Wedge contact sheets of a %dx%d frame:\n", width, height);
+  for (const auto& sheet : sheets) {
+    RenderRequest req;
+    req.params.preserveMidgray = 0.3f;
+    req.params.pShadow[0] = 0.7f; req.params.pShadow[2] = 1.6f;
+    req.params.pHighlight[0] = 1.5f; req.params.pHighlight[1] = 0.5f;
+    req.params.kernel = sheet.kernel;
+    req.wedge.count = sheet.count;
+    req.wedge.target = sheet.target;
+    req.wedge.spread = sheet.spread;
+    req.threading = kThreadingPool;
+    req.cpus = 3;
+
+    // The expected sheet, top row of cells first; unused cells and leftovers stay 0.
+    const int cols = (int)std::ceil(std::sqrt((double)sheet.count));
+    const int rows = (sheet.count + cols - 1) / cols;
+    const int cellW = width / cols, cellH = height / rows;
+    const RowKernelFn kernel = selectRowKernel(req.params);
+    std::vector<float> expected((std::size_t)width * height * 4, 0.0f);
+    std::vector<float> scaled((std::size_t)cellW * 4);
+    for (int k = 0; k < sheet.count; ++k) {
+      const CurveSetup variant = makeWedgeVariant(req.params, req.wedge, k);
+      const int cx = (k % cols) * cellW;
+      for (int v = 0; v < cellH; ++v) {
+        const int sy = height - 1 - v * height / cellH; // rows counted from the bottom
+        for (int u = 0; u < cellW; ++u) {
+          std::memcpy(&scaled[(std::size_t)u * 4], &frame[((std::size_t)sy * width + u * width / cellW) * 4],
+                      4 * sizeof(float));
+        }
+        const int y = height - 1 - ((k / cols) * cellH + v);
+        kernel(scaled.data(), &expected[((std::size_t)y * width + cx) * 4], cellW, variant);
+      }
+    }
+
+    for (const Tiling& tiling : tilings) {
+      SplitToneRenderer renderer;
+      std::fill(dstPixels.begin(), dstPixels.end(), (unsigned char)0xa5);
+      for (const OfxRectI& w : tileWindows(bounds, tiling.w, tiling.h)) {
+        req.window = w;
+        renderer.render(src, dst, req);
+      }
+      std::size_t wrongCells = 0, uncleared = 0;
+      const float* out = (const float*)dstPixels.data();
+      for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+          const std::size_t at = ((std::size_t)y * width + x) * 4;
+          if (std::memcmp(&out[at], &expected[at], 4 * sizeof(float)) == 0) continue;
+          const int r = (height - 1 - y) / cellH, col = x / cellW;
+          if (r < rows && col < cols && r * cols + col < sheet.count) ++wrongCells;
+          else ++uncleared;
+        }
+      }
+      const bool ok = !wrongCells && !uncleared;
+      std::printf("  %d variants (%dx%d cells of %dx%d), %s windows: %zu cell pixels differ, %zu other pixels "
+                  "not cleared%s\n", sheet.count, cols, rows, cellW, cellH, tiling.name, wrongCells, uncleared,
+                  ok ? "" : " FAIL");
+      pass = pass && ok;
+    }
+  }
+  return pass;
+}
+
+// allocations: once warm, a render allocates nothing from the heap: not in the renderer, the
+// processor, the threading backends, the caches or the scratch arenas. Each scenario renders a few
+// times to warm up, then counts every operator new over more renders of the same kind. Cache
+// misses allocate by design (a half table for a new grade, LUT coordinates for a frame seen again,
+// the first static-tile frame of a window) and are not part of the steady state.
+static bool testAllocations() {
+  const OfxRectI bounds = {0, 0, 320, 180};
+  const int width = bounds.x2 - bounds.x1;
+  const int height = bounds.y2 - bounds.y1;
+  const std::vector<float> inputs = validationInputs();
+  std::vector<float> frame((std::size_t)width * height * 4);
+  for (std::size_t i = 0; i < frame.size(); ++i) frame[i] = inputs[(i * 2654435761u) % inputs.size()];
+
+  struct Scenario {
+    const char* name;
+    OFX::BitDepthEnum srcDepth;
+    OFX::BitDepthEnum dstDepth;
+    int threading;
+    unsigned int cpus;
+    void (*setup)(RenderRequest& req);
+    void (*step)(RenderRequest& req, int i); // what changes from one render to the next
+  };
+  const unsigned int hw = std::max(2u, std::thread::hardware_concurrency());
+  auto playback = [](RenderRequest& req, int i) { req.time = (double)i; };
+  auto sliderDrag = [](RenderRequest& req, int i) { req.params.pShadow[0] = 0.5f + 0.01f * (float)i; };
+  const Scenario scenarios[] = {
+    {"inline, burned-in curve, playback", OFX::eBitDepthFloat, OFX::eBitDepthFloat, kThreadingPool, 1,
+     [](RenderRequest& req) { req.params.burnInCurve = true; }, playback},
+    {"inline, slider drag", OFX::eBitDepthFloat, OFX::eBitDepthFloat, kThreadingPool, 1,
+     [](RenderRequest&) {}, sliderDrag},
+    {"pool, fast, playback", OFX::eBitDepthFloat, OFX::eBitDepthFloat, kThreadingPool, hw,
+     [](RenderRequest& req) { req.params.kernel = kKernelFast; }, playback},
+    {"half table, pool, playback", OFX::eBitDepthHalf, OFX::eBitDepthHalf, kThreadingPool, hw,
+     [](RenderRequest&) {}, playback},
+    {"8-bit, blue noise, playback", OFX::eBitDepthFloat, OFX::eBitDepthUByte, kThreadingPool, hw,
+     [](RenderRequest& req) {
+       req.dither.mode = kDitherBlueNoise;
+       req.dither.pattern = ditherPattern(req.dither.mode, req.dither.size);
+     }, playback},
+    {"wedge, playback", OFX::eBitDepthFloat, OFX::eBitDepthUShort, kThreadingPool, hw,
+     [](RenderRequest& req) { req.wedge.count = 6; }, playback},
+    {"static tiles, playback", OFX::eBitDepthFloat, OFX::eBitDepthHalf, kThreadingPool, hw,
+     [](RenderRequest& req) { req.reuseStaticTiles = true; }, playback},
+    {"static tiles, slider drag", OFX::eBitDepthFloat, OFX::eBitDepthFloat, kThreadingPool, hw,
+     [](RenderRequest& req) { req.reuseStaticTiles = true; }, sliderDrag},
+    {"slider preview LUT, slider drag", OFX::eBitDepthFloat, OFX::eBitDepthFloat, kThreadingPool, hw,
+     [](RenderRequest& req) {
+       req.interactive = true;
+       req.fastSliderPreview = true;
+     }, sliderDrag},
+    {"slider preview LUT, playback", OFX::eBitDepthFloat, OFX::eBitDepthFloat, kThreadingPool, hw,
+     [](RenderRequest& req) {
+       req.interactive = true;
+       req.fastSliderPreview = true;
+     }, playback},
+  };
+
+  const int kWarmRenders = 3;
+  const int kCountedRenders = 8;
+  bool pass = true;
+  std::printf("Heap allocations per scenario over %d warm renders:\n", kCountedRenders);
+  for (const Scenario& s : scenarios) {
+    std::vector<unsigned char> srcPixels, dstPixels;
+    const ImageView src = makeView(srcPixels, s.srcDepth, bounds);
+    const ImageView dst = makeView(dstPixels, s.dstDepth, bounds);
+    for (int y = 0; y < height; ++y) {
+      storeRow(s.srcDepth, &frame[(std::size_t)y * width * 4], src.getPixelAddress(bounds.x1, bounds.y1 + y), width);
+    }
+
+    SplitToneRenderer renderer;
+    RenderRequest req;
+    req.window = bounds;
+    req.threading = s.threading;
+    req.cpus = s.cpus;
+    req.params.preserveMidgray = 0.25f;
+    req.params.pHighlight[1] = 1.4f;
+    s.setup(req);
+
+    uint64_t allocations = 0;
+    for (int i = 0; i < kWarmRenders + kCountedRenders; ++i) {
+      s.step(req, i);
+      const uint64_t before = gHeapAllocations.load();
+      renderer.render(src, dst, req);
+      if (i >= kWarmRenders) allocations += gHeapAllocations.load() - before;
+    }
+    pass = pass && allocations == 0;
+    std::printf("  %s: %llu%s\n", s.name, (unsigned long long)allocations, allocations ? " FAIL" : "");
+  }
+  return pass;
+}
+
+// hostcalls: renderAction and isIdentityAction against a stand-in host whose images, params and
+// threads each take a set time. Every host call must be booked once under its action, for at least
+// the injected latency and not much more, and the time the host threading backend spends outside
+// the workers as dispatch.
+class SimulatedHost : public RenderHost {
+public:
+  ImageView src, dst;
+  RenderRequest settings; // handed out by fetchRenderParams
+  ParamsSnapshot identityParams;
+  std::chrono::microseconds imagesLatency{0}, paramsLatency{0}, threadsLatency{0};
+
+  void fetchImages(double, ImageView& s, ImageView& d) override {
+    std::this_thread::sleep_for(imagesLatency);
+    s = src;
+    d = dst;
+  }
+  void fetchRenderParams(double, RenderRequest& req) override {
+    std::this_thread::sleep_for(paramsLatency);
+    req = settings;
+  }
+  void fetchIdentityParams(double, ParamsSnapshot& p, int& ditherMode, WedgeSetup& wedge) override {
+    std::this_thread::sleep_for(paramsLatency);
+    p = identityParams;
+    ditherMode = kDitherOff;
+    wedge = WedgeSetup();
+  }
+  // Latency before the threads start and after the last one ends, as a host suite spends it.
+  void multiThread(int nChunks, unsigned int maxThreads, const ChunkFn& fn) override {
+    std::this_thread::sleep_for(threadsLatency);
+    std::atomic<int> next{0};
+    ChunkError error;
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < maxThreads; ++t) {
+      threads.emplace_back([&] {
+        try {
+          for (int c = next.fetch_add(1); c < nChunks && !error.stopped(); c = next.fetch_add(1)) fn(c);
+        } catch (...) {
+          error.capture();
+        }
+      });
+    }
+    for (std::thread& t : threads) t.join();
+    std::this_thread::sleep_for(threadsLatency);
+    error.rethrow();
+  }
+  bool aborted() const override { return false; }
+};
+
+static bool testHostCalls() {
+  const OfxRectI bounds = {0, 0, 1024, 512};
+  const int width = bounds.x2 - bounds.x1;
+  const int height = bounds.y2 - bounds.y1;
+  const std::vector<float> inputs = validationInputs();
+  std::vector<float> frame((std::size_t)width * height * 4);
+  for (std::size_t i = 0; i < frame.size(); ++i) frame[i] = inputs[(i * 2654435761u) % inputs.size()];
+
+  std::vector<unsigned char> srcPixels, dstPixels;
+  SimulatedHost host;
+  host.src = makeView(srcPixels, OFX::eBitDepthFloat, bounds);
+  host.dst = makeView(dstPixels, OFX::eBitDepthFloat, bounds);
+  std::memcpy(srcPixels.data(), frame.data(), srcPixels.size());
+  host.settings.params.pShadow[0] = 0.6f;
+  host.settings.params.pHighlight[2] = 1.4f;
+  host.settings.threading = kThreadingHost;
+  host.settings.cpus = 4;
+  host.imagesLatency = std::chrono::microseconds(2000);
+  host.paramsLatency = std::chrono::microseconds(3000);
+  host.threadsLatency = std::chrono::microseconds(1500);
+
+  const int kRenders = 4;
+  const int kIdentities = 5;
+  SplitToneRenderer renderer;
+  for (int i = 0; i < kRenders; ++i) renderAction(renderer, host, (double)i, bounds, false);
+  int identities = 0;
+  for (int i = 0; i < kIdentities; ++i) identities += isIdentityAction(renderer, host, (double)i) ? 1 : 0;
+  const StatsTotals t = renderer.stats().totals();
+
+  bool pass = true;
+  // Sleeps never end early; the slack covers a loaded machine waking them late.
+  const uint64_t kSlackNanos = 20000000;
+  auto check = [&](HostAction action, HostCall call, uint64_t calls, uint64_t minNanos) {
+    const uint64_t n = t.hostCalls[action][call];
+    const uint64_t nanos = t.hostNanos[action][call];
+    const bool ok = n == calls && nanos >= minNanos && nanos <= minNanos + calls * kSlackNanos;
+    std::printf("  %s %s: %llu calls, %.2f ms (expected %llu, at least %.2f ms)%s\n", kActionNames[action],
+                kHostCallNames[call], (unsigned long long)n, (double)nanos * 1e-6, (unsigned long long)calls,
+                (double)minNanos * 1e-6, ok ? "" : " FAIL");
+    pass = pass && ok;
+  };
+  auto nanosOf = [](std::chrono::microseconds d) { return (uint64_t)d.count() * 1000; };
+
+  std::printf("Host calls over %d renders and %d isIdentity calls:\n", kRenders, kIdentities);
+  check(kActionRender, kHostFetchImage, 2 * kRenders, kRenders * nanosOf(host.imagesLatency));
+  check(kActionRender, kHostGetParams, kRenders, kRenders * nanosOf(host.paramsLatency));
+  check(kActionRender, kHostDispatch, kRenders, 2 * kRenders * nanosOf(host.threadsLatency));
+  check(kActionIsIdentity, kHostFetchImage, 0, 0);
+  check(kActionIsIdentity, kHostGetParams, kIdentities, kIdentities * nanosOf(host.paramsLatency));
+  check(kActionIsIdentity, kHostDispatch, 0, 0);
+
+  // A wedge's workers must bound the dispatch time too.
+  SplitToneRenderer wedgeRenderer;
+  host.settings.wedge.count = 4;
+  renderAction(wedgeRenderer, host, 0.0, bounds, false);
+  const StatsTotals w = wedgeRenderer.stats().totals();
+  const uint64_t wedgeDispatch = w.hostNanos[kActionRender][kHostDispatch];
+  const bool wedgeOk = w.inlineRenders == 0 && wedgeDispatch >= 2 * nanosOf(host.threadsLatency) &&
+                       wedgeDispatch <= 2 * nanosOf(host.threadsLatency) + kSlackNanos;
+  std::printf("  wedge render multiThread: %.2f ms (at least %.2f ms)%s\n", (double)wedgeDispatch * 1e-6,
+              2e-6 * (double)nanosOf(host.threadsLatency), wedgeOk ? "" : " FAIL");
+  pass = pass && wedgeOk;
+
+  const bool threaded = t.renders == (uint64_t)kRenders && t.inlineRenders == 0;
+  const bool identical = identities == kIdentities && t.identities == (uint64_t)kIdentities;
+  std::printf("  every render on host threads: %s\n  identity params found identical: %s\n",
+              threaded ? "yes" : "NO", identical ? "yes" : "NO");
+  return pass && threaded && identical;
+}
+
+// caches: the paused-frame LUT frames and the static-tile frames of all instances together stay
+// within their stores' byte budgets, evicting the least recently used frame whichever instance it
+// belongs to, and an instance's frames go when it does. A static-tile window keeps one frame however
+// often its grade changes, and regrades every tile after a change. Instances with the same curve
+// share one baked half table; past the store's budget tables are evicted and built again correctly,
+// and lookups from many threads while others evict always get the table of their own grade.
+static bool testCaches() {
+  bool pass = true;
+  auto check = [&](bool ok, const char* what) {
+    if (!ok) std::printf("  FAIL: %s\n", what);
+    pass = pass && ok;
+  };
+  auto lutUsage = [] {
+    std::size_t frames = 0, bytes = 0;
+    LutFrameStore::instance().usage(frames, bytes);
+    return bytes;
+  };
+
+  const OfxRectI bounds = {0, 0, 1024, 1024};
+  const std::size_t frameBytes = (std::size_t)1024 * 1024 * 3 * sizeof(uint32_t);
+  std::vector<unsigned char> srcPixels, dstPixels;
+  const ImageView src = makeView(srcPixels, OFX::eBitDepthFloat, bounds);
+  const ImageView dst = makeView(dstPixels, OFX::eBitDepthFloat, bounds);
+  std::memset(srcPixels.data(), 0, srcPixels.size());
+
+  RenderRequest req;
+  req.window = bounds;
+  req.threading = kThreadingPool;
+  req.interactive = true;
+  req.fastSliderPreview = true;
+
+  // Each instance renders a paused frame three times: seen, built, reused.
+  const int kInstances = (int)(2 * LutFrameStore::kMaxBytes / frameBytes);
+  std::vector<std::unique_ptr<SplitToneRenderer>> instances;
+  std::size_t peak = 0;
+  uint64_t lutRenders = 0;
+  for (int i = 0; i < kInstances; ++i) {
+    instances.emplace_back(new SplitToneRenderer);
+    for (int k = 0; k < 3; ++k) {
+      req.params.pShadow[0] = 1.0f + 0.1f * (float)k;
+      instances.back()->render(src, dst, req);
+      peak = std::max(peak, lutUsage());
+    }
+    lutRenders += instances.back()->stats().totals().lutRenders;
+  }
+  check(lutRenders == 2 * (uint64_t)kInstances, "every instance served its paused frame from the LUT");
+  check(peak <= LutFrameStore::kMaxBytes, "LUT frames of all instances stay within the budget");
+  check(peak + frameBytes > LutFrameStore::kMaxBytes, "the budget is used before frames are evicted");
+
+  // The first instance's frame was evicted long ago, so it is built again; the last one's is reused.
+  const uint64_t builtBefore = instances.front()->stats().totals().lutBuilds;
+  instances.front()->render(src, dst, req);
+  check(instances.front()->stats().totals().lutBuilds == builtBefore + 1, "least recently used frame evicted");
+  const uint64_t lastBuilt = instances.back()->stats().totals().lutBuilds;
+  instances.back()->render(src, dst, req);
+  check(instances.back()->stats().totals().lutBuilds == lastBuilt, "recently used frame kept");
+
+  instances.clear();
+  check(lutUsage() == 0, "destroyed instances leave no LUT frames");
+
+  std::printf("LUT frames: %d instances of %.1f MB, peak %.1f MB of %.1f MB\n", kInstances,
+              (double)frameBytes / (1 << 20), (double)peak / (1 << 20),
+              (double)LutFrameStore::kMaxBytes / (1 << 20));
+
+  auto tileUsage = [](std::size_t& frames) {
+    std::size_t bytes = 0;
+    StaticTileStore::instance().usage(frames, bytes);
+    return bytes;
+  };
+  req = RenderRequest();
+  req.window = bounds;
+  req.threading = kThreadingPool;
+  req.reuseStaticTiles = true;
+  req.params.kernel = kKernelFast;
+  const std::size_t tileFrameBytes = (std::size_t)1024 * 1024 * (16 + 16); // float source and output
+  const int kTileInstances = (int)(2 * StaticTileStore::kMaxBytes / tileFrameBytes);
+  std::size_t tilePeak = 0, frames = 0;
+  bool oneFramePerWindow = true, regraded = true;
+  for (int i = 0; i < kTileInstances; ++i) {
+    instances.emplace_back(new SplitToneRenderer);
+    for (int k = 0; k < 3; ++k) {
+      req.params.pShadow[0] = k < 2 ? 1.0f : 1.5f; // the same frame twice, then a new grade
+      instances.back()->render(src, dst, req);
+      const StatsTotals s = instances.back()->stats().totals();
+      if (k == 1) regraded = regraded && s.reusedTiles == s.staticTiles / 2;
+      if (k == 2) regraded = regraded && s.reusedTiles == s.staticTiles / 3;
+      tilePeak = std::max(tilePeak, tileUsage(frames));
+      if (i == 0) oneFramePerWindow = oneFramePerWindow && frames == 1;
+    }
+  }
+  check(regraded, "tiles are reused under the same grade and regraded under a new one");
+  check(oneFramePerWindow, "a window keeps one static-tile frame across grades");
+  check(tilePeak <= StaticTileStore::kMaxBytes, "static-tile frames of all instances stay within the budget");
+  check(tilePeak + tileFrameBytes > StaticTileStore::kMaxBytes, "the budget is used before frames are evicted");
+  instances.clear();
+  check(tileUsage(frames) == 0 && frames == 0, "destroyed instances leave no static-tile frames");
+
+  std::printf("Static-tile frames: %d instances of %.1f MB, peak %.1f MB of %.1f MB\n", kTileInstances,
+              (double)tileFrameBytes / (1 << 20), (double)tilePeak / (1 << 20),
+              (double)StaticTileStore::kMaxBytes / (1 << 20));
+
+  BakedCurveStore& store = BakedCurveStore::instance();
+  store.clear();
+  auto storeUsage = [&](std::size_t& tables, uint64_t& hits, uint64_t& builds) {
+    std::size_t bytes = 0;
+    store.usage(tables, bytes, hits, builds);
+    return bytes;
+  };
+  // Grade g of a family, all with distinct curves; Reference tables hold applyCurve's bits.
+  auto grade = [](int g) {
+    ParamsSnapshot p;
+    p.preserveMidgray = 0.2f;
+    p.pShadow[0] = 0.2f + 0.01f * (float)g;
+    p.pHighlight[1] = 1.9f - 0.005f * (float)g;
+    return p;
+  };
+  auto holds = [](const HalfCurveTable& t, const ParamsSnapshot& p) {
+    const CurveSetup c = makeCurveSetup(p);
+    if (!t.matches(c, p, false) || t.single.size() != 3 * (std::size_t)kHalfValues) return false;
+    for (int ch = 0; ch < 3; ++ch) {
+      for (int h = ch; h < kHalfValues; h += 257) {
+        const float want = applyCurve(halfToFloat((uint16_t)h), c.shadowEnd, c.highlightStart, c.pShadow[ch], c.pHighlight[ch]);
+        const float got = t.single[(std::size_t)ch * kHalfValues + (std::size_t)h];
+        if (std::memcmp(&want, &got, sizeof(float)) != 0) return false;
+      }
+    }
+    return true;
+  };
+
+  std::vector<unsigned char> halfPixels, outPixels;
+  const OfxRectI small = {0, 0, 64, 32};
+  const ImageView halfSrc = makeView(halfPixels, OFX::eBitDepthHalf, small);
+  const ImageView floatDst = makeView(outPixels, OFX::eBitDepthFloat, small);
+  std::memset(halfPixels.data(), 0x3c, halfPixels.size());
+  req = RenderRequest();
+  req.window = small;
+  req.threading = kThreadingPool;
+  req.cpus = 2;
+  req.params = grade(0);
+  std::size_t tables = 0;
+  uint64_t hits = 0, builds = 0;
+  SplitToneRenderer first, second;
+  first.render(halfSrc, floatDst, req);
+  second.render(halfSrc, floatDst, req);
+  storeUsage(tables, hits, builds);
+  check(tables == 1 && builds == 1 && hits == 1, "two instances with the same curve share one half table");
+  check(store.get(req.params, false, kThreadingPool, 2).get() == store.get(grade(0), false, kThreadingPool, 2).get(),
+        "equal grades get the same half table");
+
+  const std::size_t tableBytes = 3 * (std::size_t)kHalfValues * sizeof(float);
+  const int kFits = (int)(BakedCurveStore::kMaxBytes / tableBytes);
+  const int kGrades = kFits + kFits / 2;
+  std::size_t tablePeak = 0;
+  bool built = true;
+  for (int g = 0; g < kGrades; ++g) {
+    const ParamsSnapshot p = grade(g);
+    built = built && holds(*store.get(p, false, kThreadingPool, 2), p);
+    tablePeak = std::max(tablePeak, storeUsage(tables, hits, builds));
+  }
+  check(built, "every half table holds its own grade");
+  check(tablePeak <= BakedCurveStore::kMaxBytes && tables == (std::size_t)kFits,
+        "half tables stay within the budget, which they fill");
+  const uint64_t buildsBefore = builds;
+  const std::shared_ptr<const HalfCurveTable> rebuilt = store.get(grade(0), false, kThreadingPool, 2);
+  storeUsage(tables, hits, builds);
+  check(builds == buildsBefore + 1 && holds(*rebuilt, grade(0)), "an evicted half table is built again correctly");
+  store.get(grade(kGrades - 1), false, kThreadingPool, 2);
+  storeUsage(tables, hits, builds);
+  check(builds == buildsBefore + 1, "recently used half table kept");
+
+  // More grades than fit, looked up in a shuffled order from the pool: lookups race evictions.
+  const int kLookups = 8 * kGrades;
+  std::atomic<int> wrong{0};
+  parallelFor(kThreadingPool, kLookups, std::max(4u, std::thread::hardware_concurrency()), [&](int i) {
+    const ParamsSnapshot p = grade((int)(((uint64_t)i * 2654435761u) % (uint64_t)kGrades));
+    const std::shared_ptr<const HalfCurveTable> t = store.get(p, false, kThreadingPool, 1);
+    if (!t || !holds(*t, p)) wrong.fetch_add(1);
+  });
+  const std::size_t concurrentBytes = storeUsage(tables, hits, builds);
+  check(wrong.load() == 0, "concurrent lookups during eviction get their own grade's table");
+  check(concurrentBytes <= BakedCurveStore::kMaxBytes, "half tables stay within the budget under concurrency");
+  store.clear();
+  check(storeUsage(tables, hits, builds) == 0 && tables == 0, "cleared store holds no half tables");
+
+  std::printf("Half tables: %d grades of %.2f MB, %d fit in %.1f MB; %d concurrent lookups, %llu builds in all\n",
+              kGrades, (double)tableBytes / (1 << 20), kFits, (double)BakedCurveStore::kMaxBytes / (1 << 20),
+              kLookups, (unsigned long long)builds);
+  return pass;
+}
+
+// half: the software half conversions must give exactly the bits of vcvtph2ps / vcvtps2ph,
+// which loadRow / storeRow use when the CPU has F16C, NaNs included: otherwise deterministic
+// output (alpha passes through) would differ between CPUs. Every half value is compared, and every
+// float NaN / Inf plus a sweep over the other floats. Without F16C, fixed hardware results are
+// checked instead.
+static bool testHalf() {
+  uint64_t halfMismatches = 0;
+  uint64_t floatMismatches = 0;
+  uint64_t floatsChecked = 0;
+
+  // Round trips: a half comes back from float unchanged, except that NaNs are quieted.
+  for (uint32_t h = 0; h < 65536; ++h) {
+    const uint16_t quiet = (h & 0x7c00u) == 0x7c00u && (h & 0x3ffu) ? (uint16_t)(h | 0x200u) : (uint16_t)h;
+    if (floatToHalf(halfToFloat((uint16_t)h)) != quiet) ++halfMismatches;
+  }
+
+  // What vcvtph2ps / vcvtps2ph return for signaling and quiet NaNs of either sign.
+  const struct { uint16_t half; uint32_t single; } nans[] = {
+    {0x7c01u, 0x7fc02000u}, {0xfc01u, 0xffc02000u}, {0x7dffu, 0x7fffe000u}, {0x7e00u, 0x7fc00000u},
+    {0x7fffu, 0x7fffe000u}, {0x7c00u, 0x7f800000u}, {0xfc00u, 0xff800000u},
+  };
+  for (const auto& n : nans) {
+    const float f = halfToFloat(n.half);
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    if (bits != n.single) ++halfMismatches;
+  }
+  const struct { uint32_t single; uint16_t half; } floats[] = {
+    {0x7f800001u, 0x7e00u}, {0x7fa00000u, 0x7f00u}, {0xff801fffu, 0xfe00u}, {0x7fc02000u, 0x7e01u},
+    {0x7fffffffu, 0x7fffu}, {0x7f800000u, 0x7c00u}, {0x477ff000u, 0x7c00u}, {0x477fefffu, 0x7bffu},
+  };
+  for (const auto& n : floats) {
+    float f;
+    std::memcpy(&f, &n.single, sizeof(f));
+    if (floatToHalf(f) != n.half) ++floatMismatches;
+  }
+
+  bool f16c = false;
+#ifdef SPLITTONE_X86_DISPATCH
+  f16c = cpuHasF16c();
+  if (f16c) {
+    std::vector<uint16_t> halves(65536);
+    std::vector<float> hw(65536);
+    for (uint32_t h = 0; h < 65536; ++h) halves[h] = (uint16_t)h;
+    loadHalfF16c(halves.data(), hw.data(), 65536);
+    for (uint32_t h = 0; h < 65536; ++h) {
+      const float sw = halfToFloat((uint16_t)h);
+      if (std::memcmp(&sw, &hw[h], sizeof(float)) != 0) ++halfMismatches;
+    }
+
+    // All 2^24 floats with an all-ones exponent, then every 61st of the rest (in blocks of 8).
+    const int kBlock = 8;
+    uint32_t bits[kBlock];
+    float in[kBlock];
+    uint16_t out[kBlock];
+    auto check = [&](uint32_t first) {
+      for (int k = 0; k < kBlock; ++k) bits[k] = first + (uint32_t)k;
+      std::memcpy(in, bits, sizeof(in));
+      storeHalfF16c(in, out, kBlock);
+      for (int k = 0; k < kBlock; ++k) {
+        if (out[k] != floatToHalf(in[k])) ++floatMismatches;
+      }
+      floatsChecked += kBlock;
+    };
+    for (uint32_t sign = 0; sign < 2; ++sign) {
+      for (uint32_t m = 0; m < (1u << 23); m += kBlock) check((sign << 31) | 0x7f800000u | m);
+    }
+    for (uint64_t x = 0; x < (1ull << 32); x += 61 * kBlock) {
+      if (((uint32_t)x & 0x7f800000u) != 0x7f800000u) check((uint32_t)x);
+    }
+  }
+#endif
+
+  std::printf("Half conversions (%s): %llu half-to-float and %llu float-to-half mismatches, %llu floats "
+              "compared with vcvtps2ph\n", f16c ? "against F16C" : "no F16C, fixed values only",
+              (unsigned long long)halfMismatches, (unsigned long long)floatMismatches,
+              (unsigned long long)floatsChecked);
+  return !halfMismatches && !floatMismatches;
+}
+
+// halftables: every entry of a half curve table must be exactly the bits the arithmetic path gives
+// the same half: applyCurve (or its portable-pow twin in deterministic mode) on the converted float
+// for the Reference kernel, and the Fast kernel run over all 65536 values laid out differently
+// (channels rotated, alpha varying) for Fast. Half-output tables hold those floats converted to half.
+static bool testHalfTables() {
+  bool pass = true;
+  ParamsSnapshot graded;
+  graded.preserveMidgray = 0.35f;
+  graded.pShadow[0] = 0.6f; graded.pShadow[1] = 1.3f; graded.pShadow[2] = 1.8f;
+  graded.pHighlight[0] = 1.7f; graded.pHighlight[1] = 0.45f; graded.pHighlight[2] = 1.2f;
+  const ParamsSnapshot grades[] = {ParamsSnapshot(), graded};
+
+  // Pixel i holds value i in red, i + 21845 in green and i + 43690 in blue.
+  auto rotated = [](int i, int ch) { return (uint16_t)((i + 21845 * ch) & 0xffff); };
+  std::vector<float> row(4 * (std::size_t)kHalfValues);
+  std::vector<float> graded4(row.size());
+  for (int i = 0; i < kHalfValues; ++i) {
+    for (int ch = 0; ch < 3; ++ch) row[4 * (std::size_t)i + ch] = halfToFloat(rotated(i, ch));
+    row[4 * (std::size_t)i + 3] = halfToFloat((uint16_t)(kHalfValues - 1 - i));
+  }
+
+  std::vector<float> expected(3 * (std::size_t)kHalfValues);
+  for (std::size_t g = 0; g < sizeof(grades) / sizeof(grades[0]); ++g) {
+    for (int kernel = kKernelReference; kernel <= kKernelFast; ++kernel) {
+      for (int deterministic = 0; deterministic < 2; ++deterministic) {
+        ParamsSnapshot p = grades[g];
+        p.kernel = kernel;
+        p.deterministic = deterministic != 0;
+        const CurveSetup c = makeCurveSetup(p);
+
+        if (kernel == kKernelFast) {
+          selectRowKernel(p)(row.data(), graded4.data(), kHalfValues, c);
+          for (int i = 0; i < kHalfValues; ++i) {
+            for (int ch = 0; ch < 3; ++ch) {
+              expected[(std::size_t)ch * kHalfValues + rotated(i, ch)] = graded4[4 * (std::size_t)i + ch];
+            }
+          }
+        } else {
+          for (int ch = 0; ch < 3; ++ch) {
+            for (int h = 0; h < kHalfValues; ++h) {
+              const float x = halfToFloat((uint16_t)h);
+              const float ps = c.pShadow[ch];
+              const float ph = c.pHighlight[ch];
+              expected[(std::size_t)ch * kHalfValues + h] =
+                  p.deterministic ? applyCurveWith<PortablePow>(x, c.shadowEnd, c.highlightStart, ps, ph)
+                                  : applyCurve(x, c.shadowEnd, c.highlightStart, ps, ph);
+            }
+          }
+        }
+
+        for (int halfOut = 0; halfOut < 2; ++halfOut) {
+          const std::shared_ptr<HalfCurveTable> t = buildHalfCurveTable(p, halfOut != 0, kThreadingPool, 2);
+          uint64_t mismatches = 0;
+          for (std::size_t at = 0; at < expected.size(); ++at) {
+            if (halfOut) {
+              if (t->half[at] != floatToHalf(expected[at])) ++mismatches;
+            } else if (std::memcmp(&t->single[at], &expected[at], sizeof(float)) != 0) {
+              ++mismatches;
+            }
+          }
+          std::printf("%s grade, %s%s, %s table: %llu of %llu entries differ\n", g ? "split-tone" : "identity",
+                      kernel == kKernelFast ? "Fast" : "Reference", p.deterministic ? " deterministic" : "",
+                      halfOut ? "half" : "float", (unsigned long long)mismatches,
+                      (unsigned long long)expected.size());
+          pass = pass && !mismatches;
+        }
+      }
+    }
+  }
+  return pass;
+}
+
+// dither: storeRowDithered straight on rows, for both patterns, both target precisions and every
+// output depth. Each code is within one level of plain rounding, a flat input tiled over a whole
+// pattern averages to its exact level (the thresholds add no bias), and both patterns are
+// permutations of 0..N-1.
+static bool testDither() {
+  bool pass = true;
+  auto check = [&](bool ok, const char* what) {
+    if (!ok) std::printf("  FAIL: %s\n", what);
+    pass = pass && ok;
+  };
+  auto isPermutation = [](std::vector<int> ranks) {
+    std::sort(ranks.begin(), ranks.end());
+    for (std::size_t i = 0; i < ranks.size(); ++i) {
+      if (ranks[i] != (int)i) return false;
+    }
+    return true;
+  };
+
+  check(isPermutation(voidAndClusterRanks(kBlueNoiseSize)), "void-and-cluster ranks");
+  for (int mode : {kDitherOrdered, kDitherBlueNoise}) {
+    int size = 0;
+    const float* t = ditherPattern(mode, size);
+    const int n = size * size;
+    std::vector<int> ranks((std::size_t)n);
+    bool inside = true;
+    for (int i = 0; i < n; ++i) {
+      inside = inside && t[i] > -0.5f && t[i] < 0.5f;
+      ranks[(std::size_t)i] = (int)std::floor((t[i] + 0.5f) * (float)n);
+    }
+    check(size == (mode == kDitherOrdered ? kBayerSize : kBlueNoiseSize), "pattern size");
+    check(inside, "thresholds inside (-0.5, 0.5)");
+    check(isPermutation(ranks), mode == kDitherOrdered ? "Bayer ranks" : "blue-noise ranks");
+  }
+
+  // Codes read back from a stored pixel, as levels of 2^bits - 1.
+  auto decode = [](OFX::BitDepthEnum depth, const std::vector<unsigned char>& row, int i, int ch, int maxLevel) {
+    const std::size_t k = 4 * (std::size_t)i + (std::size_t)ch;
+    switch (depth) {
+    case OFX::eBitDepthUByte: return (int)row[k];
+    case OFX::eBitDepthUShort: {
+      uint16_t v;
+      std::memcpy(&v, row.data() + 2 * k, sizeof(v));
+      return (int)(((uint32_t)v * (uint32_t)maxLevel + 32767u) / 65535u);
+    }
+    case OFX::eBitDepthHalf: {
+      uint16_t v;
+      std::memcpy(&v, row.data() + 2 * k, sizeof(v));
+      return (int)std::lround(halfToFloat(v) * (float)maxLevel);
+    }
+    default: {
+      float v;
+      std::memcpy(&v, row.data() + 4 * k, sizeof(v));
+      return (int)std::lround(v * (float)maxLevel);
+    }
+    }
+  };
+
+  const OFX::BitDepthEnum depths[] = {OFX::eBitDepthUByte, OFX::eBitDepthUShort, OFX::eBitDepthHalf, OFX::eBitDepthFloat};
+  const float flats[] = {0.0f, 0.0421f, 0.25f, 0.3333f, 0.5f, 0.61803f, 0.9f, 0.99937f, 1.0f};
+  int cases = 0;
+  double worstBias = 0.0;
+  for (int mode : {kDitherOrdered, kDitherBlueNoise}) {
+    for (int bits : {8, 10}) {
+      for (OFX::BitDepthEnum depth : depths) {
+        DitherSetup d;
+        d.mode = mode;
+        d.bits = bits;
+        d.pattern = ditherPattern(mode, d.size);
+        const int maxLevel = (1 << (depth == OFX::eBitDepthUByte ? 8 : bits)) - 1;
+        const std::size_t bytes = depth == OFX::eBitDepthUByte ? 1 : depth == OFX::eBitDepthFloat ? 4 : 2;
+        // One pattern tile, shifted so that rows and columns wrap around it.
+        const int n = d.size, x0 = 37, y0 = -11;
+        std::vector<unsigned char> out((std::size_t)n * 4 * bytes);
+        std::vector<float> src((std::size_t)n * 4);
+        ++cases;
+
+        // A ramp past both ends of the range, a different offset in every channel.
+        bool near = true;
+        for (int y = y0; y < y0 + n; ++y) {
+          for (int i = 0; i < n; ++i) {
+            for (int ch = 0; ch < 3; ++ch) src[4 * (std::size_t)i + ch] = -0.1f + 1.2f * (float)(i + ch * 7 + (y - y0) * n) / (float)(n * n);
+            src[4 * (std::size_t)i + 3] = 1.0f;
+          }
+          storeRowDithered(d, depth, src.data(), out.data(), n, x0, y);
+          for (int i = 0; i < n; ++i) {
+            for (int ch = 0; ch < 3; ++ch) {
+              const int plain = (int)(unitClamp(src[4 * (std::size_t)i + ch]) * (float)maxLevel + 0.5f);
+              near = near && std::abs(decode(depth, out, i, ch, maxLevel) - plain) <= 1;
+            }
+          }
+        }
+        check(near, "codes within one level of plain rounding");
+
+        // Flat inputs: the mean code over the tile is the input level, to within the pattern's step.
+        bool unbiased = true;
+        for (float v : flats) {
+          for (int i = 0; i < n; ++i) {
+            for (int ch = 0; ch < 4; ++ch) src[4 * (std::size_t)i + ch] = v;
+          }
+          int64_t sum = 0;
+          for (int y = y0; y < y0 + n; ++y) {
+            storeRowDithered(d, depth, src.data(), out.data(), n, x0, y);
+            for (int i = 0; i < n; ++i) {
+              for (int ch = 0; ch < 3; ++ch) sum += decode(depth, out, i, ch, maxLevel);
+            }
+          }
+          const double bias = (double)sum / (3.0 * n * n) - (double)v * maxLevel;
+          worstBias = std::max(worstBias, std::fabs(bias) * n * n);
+          unbiased = unbiased && std::fabs(bias) <= 2.0 / (n * n);
+        }
+        check(unbiased, "flat input averages to its level");
+      }
+    }
+  }
+
+  std::printf("Dither: %d pattern/precision/depth combinations, worst flat-field bias %.2f pattern steps\n",
+              cases, worstBias);
+  return pass;
+}
+
+// upgrade: values saved before 1.1 (paramsVersion 0) with Show Curve on come back with Burn In
+// Curve on, as the curve used to be drawn into the image; nothing else about Burn In Curve changes,
+// and values already at kParamsVersion are left alone. The write path runs on stand-in params: a
+// keyframed Show Curve must come back as the same keys on Burn In Curve, and an instance with
+// nothing to carry over (a new one) must get no write but the paramsVersion stamp, and that only once.
+template <class T>
+struct FakeParam {
+  T value{};
+  std::vector<std::pair<double, T>> keys; // sorted by time
+  int writes = 0;
+
+  unsigned int getNumKeys() const { return (unsigned int)keys.size(); }
+  double getKeyTime(int k) const { return keys[(std::size_t)k].first; }
+  void getValue(T& v) const { v = value; }
+  // Boolean and integer params hold each key's value until the next one, and the first before it.
+  void getValueAtTime(double time, T& v) const {
+    v = keys.empty() ? value : keys.front().second;
+    for (const auto& k : keys) {
+      if (k.first <= time) v = k.second;
+    }
+  }
+  void setValue(T v) {
+    value = v;
+    ++writes;
+  }
+  void setValueAtTime(double time, T v) {
+    auto at = std::lower_bound(keys.begin(), keys.end(), time,
+                               [](const std::pair<double, T>& k, double t) { return k.first < t; });
+    if (at != keys.end() && at->first == time) at->second = v;
+    else keys.insert(at, std::make_pair(time, v));
+    ++writes;
+  }
+};
+
+static bool testUpgrade() {
+  const struct { int version; bool showCurve; bool burnInCurve; bool expected; } snapshots[] = {
+    {0, true, false, true}, {0, true, true, true}, {0, false, false, false}, {0, false, true, true},
+    {kParamsVersion, true, false, false}, {kParamsVersion, false, true, true},
+  };
+  bool pass = true;
+  for (const auto& s : snapshots) {
+    const bool burnIn = upgradedBurnInCurve(s.version, s.showCurve, s.burnInCurve);
+    const bool ok = burnIn == s.expected;
+    std::printf("version %d, Show Curve %s, Burn In Curve %s: Burn In Curve %s%s\n", s.version,
+                s.showCurve ? "on" : "off", s.burnInCurve ? "on" : "off", burnIn ? "on" : "off", ok ? "" : " FAIL");
+    pass = pass && ok;
+  }
+
+  auto check = [&](bool ok, const char* what) {
+    std::printf("  %s: %s\n", what, ok ? "ok" : "FAIL");
+    pass = pass && ok;
+  };
+
+  // An instance's params and the edit blocks it opens while it is created.
+  struct Instance {
+    FakeParam<int> paramsVersion;
+    FakeParam<bool> showCurve;
+    FakeParam<bool> burnInCurve;
+    int editBlocks = 0;
+    bool inEditBlock = false;
+    bool upgraded = false;
+
+    void beginEditBlock(const char*) {
+      ++editBlocks;
+      inEditBlock = true;
+    }
+    void endEditBlock() { inEditBlock = false; }
+    void create() { upgraded = upgradeParamsOnCreate(*this, paramsVersion, showCurve, burnInCurve); }
+    int writes() const { return paramsVersion.writes + showCurve.writes + burnInCurve.writes; }
+  };
+
+  Instance fresh;
+  fresh.create();
+  check(!fresh.upgraded && fresh.writes() == 0 && fresh.editBlocks == 0,
+        "new instance: no edit block, nothing written on creation");
+  check(stampParamsVersion(fresh.paramsVersion) && fresh.paramsVersion.value == kParamsVersion,
+        "new instance: stamped later");
+  check(!stampParamsVersion(fresh.paramsVersion) && fresh.writes() == 1, "new instance: stamped only once");
+
+  Instance shown;
+  shown.showCurve.value = true;
+  shown.create();
+  check(shown.upgraded && shown.editBlocks == 1 && !shown.inEditBlock && shown.burnInCurve.value &&
+          shown.burnInCurve.keys.empty() && shown.paramsVersion.value == kParamsVersion,
+        "static Show Curve on: Burn In Curve on, stamped");
+
+  Instance keyed;
+  keyed.showCurve.keys = {{0.0, false}, {10.0, true}, {20.0, false}, {35.5, true}};
+  keyed.create();
+  bool sameAtEveryTime = keyed.burnInCurve.keys.size() == keyed.showCurve.keys.size();
+  for (double t = -5.0; t <= 45.0; t += 0.5) {
+    bool show = false, burnIn = false;
+    keyed.showCurve.getValueAtTime(t, show);
+    keyed.burnInCurve.getValueAtTime(t, burnIn);
+    sameAtEveryTime = sameAtEveryTime && show == burnIn;
+  }
+  check(keyed.upgraded && sameAtEveryTime && keyed.paramsVersion.value == kParamsVersion,
+        "keyframed Show Curve: Burn In Curve has the same keys");
+
+  Instance keyedOff;
+  keyedOff.showCurve.keys = {{0.0, false}, {24.0, false}};
+  keyedOff.create();
+  check(keyedOff.upgraded && keyedOff.burnInCurve.keys.size() == 2 && !keyedOff.burnInCurve.keys[0].second &&
+          !keyedOff.burnInCurve.keys[1].second,
+        "keyframed Show Curve, always off: Burn In Curve stays off");
+
+  Instance current;
+  current.paramsVersion.value = kParamsVersion;
+  current.showCurve.keys = {{0.0, true}};
+  current.create();
+  check(!current.upgraded && current.writes() == 0 && current.editBlocks == 0 &&
+          !stampParamsVersion(current.paramsVersion),
+        "current version: nothing written");
+  return pass;
+}
+
+// baseline: SplitToneBench's baseline files must read back exactly as written, and every malformed
+// or truncated file must be rejected rather than half-read. The Mann-Whitney test must flag a
+// clearly slower run, and neither a faster one nor a run of a configuration the baseline lacks.
+static bool testBaseline() {
+  bool pass = true;
+  auto check = [&](bool ok, const char* what) {
+    if (!ok) std::printf("  FAIL: %s\n", what);
+    pass = pass && ok;
+  };
+
+  std::vector<BenchSamples> written(2);
+  written[0].tag = "reference/float/1920x1080/pool/all";
+  written[1].tag = "fast/half/64x64/pool/1";
+  for (int i = 0; i < 15; ++i) {
+    written[0].samples.push_back(3.5e7 + 1234.5678 * i);
+    written[1].samples.push_back(1.25e9 - 98765.4321 * i);
+  }
+  const std::string text = formatBaselineJson(written);
+  Baseline read;
+  check(parseBaselineJson(text, read), "written baseline reads back");
+  bool same = read.configs.size() == written.size();
+  for (std::size_t c = 0; same && c < written.size(); ++c) {
+    same = read.configs[c].tag == written[c].tag && read.configs[c].samples == written[c].samples;
+  }
+  check(same, "samples and tags round trip");
+  check(read.version == std::to_string(kPluginVersionMajor) + "." + std::to_string(kPluginVersionMinor),
+        "version round trips");
+
+  int acceptedPrefixes = 0;
+  for (std::size_t n = 0; n + 1 < text.size(); ++n) {
+    Baseline b;
+    if (parseBaselineJson(text.substr(0, n), b)) ++acceptedPrefixes;
+  }
+  check(acceptedPrefixes == 0, "every truncated baseline is rejected");
+
+  const char* const malformed[] = {
+    "",
+    "{}",
+    "[]",
+    "{\"format\": 1, \"samples\": [1, 2, 3]}",
+    "{\"format\": 3, \"configs\": [{\"tag\": \"a\", \"samples\": [1]}]}",
+    "{\"format\": 2}",
+    "{\"format\": 2, \"configs\": []}",
+    "{\"format\": 2, \"configs\": [{\"tag\": \"a\", \"samples\": []}]}",
+    "{\"format\": 2, \"configs\": [{\"samples\": [1]}]}",
+    "{\"format\": 2, \"configs\": [{\"tag\": \"a\", \"samples\": [1, -2]}]}",
+    "{\"format\": 2, \"configs\": [{\"tag\": \"a\", \"samples\": [1, nan]}]}",
+    "{\"format\": 2, \"configs\": [{\"tag\": \"a\", \"samples\": [1 2]}]}",
+    "{\"format\": 2, \"configs\": [{\"tag\": \"a\", \"samples\": [1,]}]}",
+    "{\"format\": 2, \"configs\": [{\"tag\": \"a\", \"samples\": [1]}, {\"tag\": \"a\", \"samples\": [2]}]}",
+    "{\"format\": 2, \"configs\": [{\"tag\": \"a\\\"b\", \"samples\": [1]}]}",
+    "{\"format\": 2, \"configs\": [{\"tag\": \"a\", \"samples\": [1], \"extra\": 0}]}",
+    "{\"format\": 2, \"configs\": [{\"tag\": \"a\", \"samples\": [1]}]} trailing",
+    "{\"format\": 2 \"configs\": [{\"tag\": \"a\", \"samples\": [1]}]}",
+    "{\"format\": \"2\", \"configs\": [{\"tag\": \"a\", \"samples\": [1]}]}",
+  };
+  int acceptedMalformed = 0;
+  for (const char* m : malformed) {
+    Baseline b;
+    if (parseBaselineJson(m, b)) {
+      std::printf("  accepted: %s\n", m);
+      ++acceptedMalformed;
+    }
+  }
+  check(acceptedMalformed == 0, "malformed baselines are rejected");
+  Baseline reordered;
+  check(parseBaselineJson(" {\"configs\":[{\"samples\":[2.5e7],\"tag\":\"a\"}],\r\n\t\"format\":2} ", reordered) &&
+          reordered.configs.size() == 1 && reordered.configs[0].samples[0] == 2.5e7,
+        "member order and whitespace are free");
+
+  check(median({3.0, 1.0, 2.0}) == 2.0 && median({4.0, 1.0, 3.0, 2.0}) == 2.5, "median");
+  std::vector<BenchSamples> slower = written, faster = written, other = written;
+  for (double& v : slower[0].samples) v *= 0.8;
+  for (double& v : faster[0].samples) v *= 1.2;
+  other[0].tag = "reference/float/3840x2160";
+  for (double& v : other[0].samples) v *= 0.5;
+  Baseline base;
+  base.configs = written;
+  bool regression = false;
+  formatBaselineComparison(slower, base, 5.0, regression);
+  check(regression, "a 20% slower run is a regression");
+  formatBaselineComparison(faster, base, 5.0, regression);
+  check(!regression, "a faster run is not a regression");
+  formatBaselineComparison(other, base, 5.0, regression);
+  check(!regression, "configurations are only compared with the same tag");
+  formatBaselineComparison(slower, base, 25.0, regression);
+  check(!regression, "a slowdown within the threshold is not a regression");
+  check(mannWhitneyLowerP(slower[0].samples, written[0].samples) < 1e-4 &&
+          mannWhitneyLowerP(written[0].samples, written[0].samples) > 0.4,
+        "Mann-Whitney p-values");
+
+  std::printf("Baseline format %d: %zu bytes, %zu prefixes and %zu malformed files checked\n", kBaselineFormat,
+              text.size(), text.size() - 1, sizeof(malformed) / sizeof(malformed[0]));
+  return pass;
+}
+
+struct TestCase {
+  const char* name;
+  bool (*run)();
+};
+
+static const TestCase kTestCases[] = {
+  {"kernels", testKernels},
+  {"determinism", testDeterminism},
+  {"overlay", testOverlay},
+  {"wedge", testWedge},
+  {"half", testHalf},
+  {"halftables", testHalfTables},
+  {"dither", testDither},
+  {"allocations", testAllocations},
+  {"hostcalls", testHostCalls},
+  {"upgrade", testUpgrade},
+  {"baseline", testBaseline},
+  {"caches", testCaches},
+};
+
+int main(int argc, char** argv) {
+  for (const TestCase& t : kTestCases) {
+    if (argc == 2 && std::strcmp(argv[1], t.name) == 0) return t.run() ? 0 : 1;
+  }
+  std::fprintf(stderr, "usage: %s <case>, one of:", argv[0]);
+  for (const TestCase& t : kTestCases) std::fprintf(stderr, " %s", t.name);
+  std::fprintf(stderr, "\n");
+  return 2;
+}